@@ -16,6 +16,12 @@ DESTDIR = $$PWD/bin
 
 QMAKE_CXXFLAGS += -std=c++17 -Wno-unused-parameter
 
+coroutines {
+    # C++20 coroutines for src/core/coro.h (evnt::Task, co_await on pools, futures, sockets)
+    QMAKE_CXXFLAGS -= -std=c++17
+    QMAKE_CXXFLAGS += -std=c++2a -fcoroutines
+}
+
 INCLUDEPATH += $$PWD/include
 
 LIBS += -L$$PWD/lib
@@ -39,6 +45,7 @@ SOURCES += \
     src/core/cmpmsgs.cpp \
     src/core/component.cpp \
     src/core/core.cpp \
+    src/core/event_recorder.cpp \
     src/core/exception.cpp \
     src/core/gameobject.cpp \
     src/core/gameobjectmanager.cpp \
@@ -53,19 +60,35 @@ SOURCES += \
     src/network/udpsocket.cpp
 
 HEADERS += \
+    src/core/adaptive_lock.h \
+    src/core/cancellation.h \
     src/core/classids.h \
     src/core/cmpmsgs.h \
     src/core/component.h \
+    src/core/coro.h \
+    src/core/copy_on_write.h \
     src/core/core.h \
     src/core/event.h \
+    src/core/event_recorder.h \
+    src/core/event_replay.h \
     src/core/exception.h \
+    src/core/executor.h \
+    src/core/future.h \
     src/core/gameobject.h \
     src/core/gameobjectmanager.h \
     src/core/memory_stream.h \
     src/core/module.h \
     src/core/object.h \
     src/core/objhandle.h \
+    src/core/parallel.h \
+    src/core/pool_allocator.h \
+    src/core/slot_map.h \
+    src/core/span.h \
+    src/core/task_function.h \
+    src/core/task_inbox.h \
     src/core/threadpool.h \
+    src/core/timer_wheel.h \
+    src/core/work_stealing_queue.h \
     src/fs/file.h \
     src/fs/file_system.h \
     src/fs/zip.h \
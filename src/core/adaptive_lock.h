@@ -0,0 +1,207 @@
+#ifndef ADAPTIVELOCK_H
+#define ADAPTIVELOCK_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+#ifdef __linux__
+#    include <linux/futex.h>
+#    include <sys/syscall.h>
+#    include <unistd.h>
+#else
+#    include <condition_variable>
+#    include <mutex>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#    include <immintrin.h>
+#endif
+
+namespace evnt
+{
+namespace detail
+{
+    /// Spin-wait hint: frees the pipeline for the sibling hyper-thread and saves power while polling
+    inline void cpu_relax()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        _mm_pause();
+#elif defined(__aarch64__)
+        asm volatile("yield" ::: "memory");
+#endif
+    }
+}   // namespace detail
+
+/// Counters of one AdaptiveLock since its creation
+struct LockStats
+{
+    std::uint64_t num_acquired  = 0;
+    std::uint64_t num_contended = 0;   // found the lock taken
+    std::uint64_t num_parked    = 0;   // of those, had to sleep in the kernel
+    std::uint64_t num_spins     = 0;   // pause instructions spent waiting, over all contended acquisitions
+};
+
+/**
+ * Mutex for short critical sections. An uncontended lock() is one CAS. A contended one spins with pause
+ * and exponential backoff for a bounded time - adapted, like glibc's adaptive mutex, to how long the lock
+ * has recently been held - then sleeps on a futex (a condition variable off Linux) until unlock() wakes it.
+ * A waiter whose holder was descheduled thus stops burning its core. Never spins on a single CPU.
+ * Satisfies Lockable, use it with std::lock_guard.
+ */
+class AdaptiveLock
+{
+public:
+    AdaptiveLock() = default;
+
+    AdaptiveLock(const AdaptiveLock &) = delete;
+    AdaptiveLock & operator=(const AdaptiveLock &) = delete;
+
+    void lock()
+    {
+        std::uint32_t expected = kUnlocked;
+        if(!m_state.compare_exchange_strong(expected, kLocked, std::memory_order_acquire,
+                                            std::memory_order_relaxed))
+        {
+            lock_contended();
+            return;
+        }
+
+        bump(m_num_acquired);
+    }
+
+    bool try_lock()
+    {
+        std::uint32_t expected = kUnlocked;
+        if(!m_state.compare_exchange_strong(expected, kLocked, std::memory_order_acquire,
+                                            std::memory_order_relaxed))
+            return false;
+
+        bump(m_num_acquired);
+        return true;
+    }
+
+    void unlock()
+    {
+        if(m_state.exchange(kUnlocked, std::memory_order_release) == kParked)
+            wake_one();
+    }
+
+    /// Relaxed snapshot, the counters may be mid-update
+    LockStats stats() const
+    {
+        LockStats res;
+        res.num_acquired  = m_num_acquired.load(std::memory_order_relaxed);
+        res.num_contended = m_num_contended.load(std::memory_order_relaxed);
+        res.num_parked    = m_num_parked.load(std::memory_order_relaxed);
+        res.num_spins     = m_num_spins.load(std::memory_order_relaxed);
+        return res;
+    }
+
+private:
+    static constexpr std::uint32_t kUnlocked = 0;
+    static constexpr std::uint32_t kLocked   = 1;
+    static constexpr std::uint32_t kParked   = 2;   // locked, and a waiter may sleep: unlock() must wake one
+
+    static constexpr std::uint32_t kMinSpins   = 10;     // pause instructions
+    static constexpr std::uint32_t kMaxSpins   = 1000;   // a few microseconds, past that sleeping is cheaper
+    static constexpr std::uint32_t kMaxBackoff = 64;
+
+    static constexpr unsigned kEstimateShift = 3;   // m_spin_estimate holds the average << 3
+
+    void lock_contended()
+    {
+        static const bool can_spin = std::thread::hardware_concurrency() > 1;
+
+        // Up to twice what recent contended acquisitions needed
+        const std::uint32_t estimate = m_spin_estimate.load(std::memory_order_relaxed) >> kEstimateShift;
+        const std::uint32_t limit    = std::min(kMaxSpins, 2 * estimate + kMinSpins);
+
+        std::uint32_t spins   = 0;
+        std::uint32_t backoff = 1;
+        while(can_spin && spins < limit)
+        {
+            for(std::uint32_t i = 0; i < backoff; ++i)
+                detail::cpu_relax();
+            spins += backoff;
+            backoff = std::min(backoff * 2, kMaxBackoff);
+
+            std::uint32_t expected = kUnlocked;
+            if(m_state.load(std::memory_order_relaxed) == kUnlocked
+               && m_state.compare_exchange_weak(expected, kLocked, std::memory_order_acquire,
+                                                std::memory_order_relaxed))
+            {
+                acquired_contended(spins, false);
+                return;
+            }
+        }
+
+        // Taken as kParked, whether or not others sleep: the unlock() that follows wakes one just in case
+        bool parked = false;
+        while(m_state.exchange(kParked, std::memory_order_acquire) != kUnlocked)
+        {
+            park();
+            parked = true;
+        }
+
+        acquired_contended(spins, parked);
+    }
+
+    /// Under the lock, so the counters are only ever written by the holder
+    void acquired_contended(std::uint32_t spins, bool parked)
+    {
+        bump(m_num_acquired);
+        bump(m_num_contended);
+        m_num_spins.store(m_num_spins.load(std::memory_order_relaxed) + spins, std::memory_order_relaxed);
+        if(parked)
+            bump(m_num_parked);
+
+        // Moving average (weight 1/8) of the spins that paid off, a wait that ended in the kernel counts as
+        // none: the lock is held too long for spinning, so the next waiters give up sooner. Kept in fixed
+        // point, e -= e/8 on the scaled value loses nothing to truncation and converges to the samples.
+        const std::uint32_t estimate = m_spin_estimate.load(std::memory_order_relaxed);
+        const std::uint32_t sample   = parked ? 0 : spins;
+        m_spin_estimate.store(estimate - (estimate >> kEstimateShift) + sample, std::memory_order_relaxed);
+    }
+
+    static void bump(std::atomic<std::uint64_t> & counter)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+#ifdef __linux__
+    std::uint32_t * futex_word() { return reinterpret_cast<std::uint32_t *>(&m_state); }
+
+    void park() { syscall(SYS_futex, futex_word(), FUTEX_WAIT_PRIVATE, kParked, nullptr, nullptr, 0); }
+    void wake_one() { syscall(SYS_futex, futex_word(), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0); }
+#else
+    void park()
+    {
+        std::unique_lock<std::mutex> lk(m_park_mutex);
+        m_park_cv.wait(lk, [this] { return m_state.load(std::memory_order_relaxed) != kParked; });
+    }
+
+    void wake_one()
+    {
+        // A waiter checks the state under m_park_mutex, it is either awake or already waiting
+        { std::lock_guard<std::mutex> lk(m_park_mutex); }
+        m_park_cv.notify_one();
+    }
+
+    std::mutex              m_park_mutex;
+    std::condition_variable m_park_cv;
+#endif
+
+    static_assert(sizeof(std::atomic<std::uint32_t>) == sizeof(std::uint32_t), "futex needs a plain word");
+
+    std::atomic<std::uint32_t> m_state         = {kUnlocked};
+    std::atomic<std::uint32_t> m_spin_estimate = {0};
+    std::atomic<std::uint64_t> m_num_acquired  = {0};
+    std::atomic<std::uint64_t> m_num_contended = {0};
+    std::atomic<std::uint64_t> m_num_parked    = {0};
+    std::atomic<std::uint64_t> m_num_spins     = {0};
+};
+}   // namespace evnt
+
+#endif   // ADAPTIVELOCK_H
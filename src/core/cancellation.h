@@ -0,0 +1,70 @@
+#ifndef CANCELLATION_H
+#define CANCELLATION_H
+
+#include <atomic>
+#include <exception>
+#include <memory>
+
+namespace evnt
+{
+/// Result of a task that was cancelled before it started or gave up with throw_if_cancelled()
+class TaskCancelled : public std::exception
+{
+public:
+    const char * what() const noexcept override { return "task cancelled"; }
+};
+
+namespace detail
+{
+    struct CancellationState
+    {
+        std::atomic_bool cancelled = {false};
+    };
+}   // namespace detail
+
+/**
+ * Observer side, cheap to copy into tasks. A task that has not started is dropped by the pool when its
+ * token is cancelled, a running task polls is_cancelled() or calls throw_if_cancelled(). A default
+ * constructed token is never cancelled.
+ */
+class CancellationToken
+{
+public:
+    CancellationToken() = default;
+
+    bool can_be_cancelled() const { return m_state != nullptr; }
+    bool is_cancelled() const { return m_state && m_state->cancelled.load(std::memory_order_acquire); }
+
+    void throw_if_cancelled() const
+    {
+        if(is_cancelled())
+            throw TaskCancelled();
+    }
+
+private:
+    friend class CancellationSource;
+
+    explicit CancellationToken(std::shared_ptr<detail::CancellationState> state) :
+        m_state(std::move(state))
+    {}
+
+    std::shared_ptr<detail::CancellationState> m_state;
+};
+
+/// Owner side: hands out tokens and cancels all of them at once
+class CancellationSource
+{
+public:
+    CancellationSource() : m_state(std::make_shared<detail::CancellationState>()) {}
+
+    CancellationToken token() const { return CancellationToken(m_state); }
+
+    void cancel() { m_state->cancelled.store(true, std::memory_order_release); }
+    bool is_cancelled() const { return m_state->cancelled.load(std::memory_order_acquire); }
+
+private:
+    std::shared_ptr<detail::CancellationState> m_state;
+};
+}   // namespace evnt
+
+#endif   // CANCELLATION_H
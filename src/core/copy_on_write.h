@@ -0,0 +1,313 @@
+#ifndef COPYONWRITE_H
+#define COPYONWRITE_H
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace evnt
+{
+template<typename T>
+class CopyOnWrite;
+
+namespace detail
+{
+    /// Hazard pointers of one thread: only the owner fills a free slot, whoever holds the snapshot clears it
+    struct alignas(64) HazardBlock
+    {
+        static constexpr std::size_t kNumSlots = 8;
+
+        std::atomic<const void *> slots[kNumSlots] = {};
+        std::atomic_bool          owned            = {true};
+        HazardBlock *             next             = nullptr;   // all the blocks, under the domain mutex
+        HazardBlock *             next_owned       = nullptr;   // blocks of the owner thread
+    };
+
+    /**
+     * Deferred reclamation for CopyOnWrite: a replaced version is retired here and deleted once no hazard
+     * slot points to it. The slots are grouped in per-thread blocks, so a reader only ever writes a cache
+     * line of its own thread. Blocks of exited threads are adopted by new ones, or freed by retire() once
+     * their last snapshot is gone.
+     */
+    class HazardDomain
+    {
+    public:
+        using deleter_type = void (*)(const void *);
+
+        static HazardDomain & instance()
+        {
+            // Intentionally leaked: snapshots and thread_local destructors may outlive the statics
+            static HazardDomain * domain = new HazardDomain;
+            return *domain;
+        }
+
+        /// Free slot of the calling thread, it is taken as soon as a pointer is stored into it
+        std::atomic<const void *> & acquire_slot()
+        {
+            LocalBlocks & local = local_blocks();
+            for(HazardBlock * block = local.cursor; block != nullptr; block = block->next_owned)
+            {
+                if(auto * slot = free_slot(block))
+                    return *slot;
+            }
+            for(HazardBlock * block = local.head; block != local.cursor; block = block->next_owned)
+            {
+                if(auto * slot = free_slot(block))
+                {
+                    local.cursor = block;
+                    return *slot;
+                }
+            }
+
+            // More snapshots of this thread alive than slots, they may be held by calls in flight
+            for(;;)
+            {
+                HazardBlock * block = adopt_block();
+                block->next_owned   = local.head;
+                local.head          = block;
+                local.cursor        = block;
+                if(auto * slot = free_slot(block))
+                    return *slot;
+            }
+        }
+
+        /// Deletes ptr now if no snapshot holds it, otherwise at a later retire() that finds it free
+        void retire(const void * ptr, deleter_type deleter)
+        {
+            std::vector<Retired> reclaimable;
+            {
+                std::lock_guard<std::mutex> lk(m_mutex);
+                m_retired.push_back({ptr, deleter});
+
+                // After the exchange of the retiring writer, see CopyOnWrite::read()
+                m_protected.clear();
+                for(HazardBlock ** link = &m_blocks; *link != nullptr;)
+                {
+                    HazardBlock * block = *link;
+                    bool          empty = true;
+                    for(auto & slot : block->slots)
+                    {
+                        if(const void * p = slot.load())
+                        {
+                            m_protected.push_back(p);
+                            empty = false;
+                        }
+                    }
+
+                    // No thread can fill a slot of a released block, and adopt_block() is under the lock too
+                    if(empty && !block->owned.load(std::memory_order_acquire))
+                    {
+                        *link = block->next;
+                        delete block;
+                    }
+                    else
+                        link = &block->next;
+                }
+                std::sort(m_protected.begin(), m_protected.end());
+
+                auto held = std::partition(m_retired.begin(), m_retired.end(), [this](const Retired & r) {
+                    return std::binary_search(m_protected.begin(), m_protected.end(), r.ptr);
+                });
+                reclaimable.assign(held, m_retired.end());
+                m_retired.erase(held, m_retired.end());
+            }
+
+            // Outside the lock, a deleted value may retire cells of its own
+            for(const Retired & r : reclaimable)
+                r.deleter(r.ptr);
+        }
+
+    private:
+        struct Retired
+        {
+            const void * ptr;
+            deleter_type deleter;
+        };
+
+        // Trivially destructible, so it stays usable by other thread_local destructors at thread exit
+        struct LocalBlocks
+        {
+            HazardBlock * head   = nullptr;
+            HazardBlock * cursor = nullptr;   // where the last free slot was found
+            bool          closed = false;
+        };
+
+        struct LocalBlocksReleaser
+        {
+            ~LocalBlocksReleaser()
+            {
+                LocalBlocks & local = local_blocks();
+                for(HazardBlock * block = local.head; block != nullptr;)
+                {
+                    // Read before the release, the block may be adopted right after it
+                    HazardBlock * next = block->next_owned;
+                    block->owned.store(false, std::memory_order_release);
+                    block = next;
+                }
+
+                // Reads from later thread_local destructors take blocks of their own, never released
+                local = LocalBlocks();
+                local.closed = true;
+            }
+        };
+
+        HazardDomain() = default;
+
+        static LocalBlocks & local_blocks()
+        {
+            static thread_local LocalBlocks blocks;
+            if(!blocks.closed)
+            {
+                static thread_local LocalBlocksReleaser releaser;
+                (void)releaser;
+            }
+            return blocks;
+        }
+
+        static std::atomic<const void *> * free_slot(HazardBlock * block)
+        {
+            for(auto & slot : block->slots)
+            {
+                if(slot.load(std::memory_order_relaxed) == nullptr)
+                    return &slot;
+            }
+            return nullptr;
+        }
+
+        /// A block released by an exited thread, or a new one. Its slots may still be held by snapshots
+        HazardBlock * adopt_block()
+        {
+            std::lock_guard<std::mutex> lk(m_mutex);
+            for(HazardBlock * block = m_blocks; block != nullptr; block = block->next)
+            {
+                bool owned = false;
+                if(block->owned.compare_exchange_strong(owned, true, std::memory_order_acquire))
+                    return block;
+            }
+
+            auto * block = new HazardBlock;
+            block->next  = m_blocks;
+            m_blocks     = block;
+            return block;
+        }
+
+        std::mutex                m_mutex;              // serializes retire() and adopt_block()
+        HazardBlock *             m_blocks = nullptr;   // under m_mutex
+        std::vector<Retired>      m_retired;            // under m_mutex
+        std::vector<const void *> m_protected;          // scratch of retire(), under m_mutex
+    };
+}   // namespace detail
+
+/**
+ * One published version of a CopyOnWrite value, stays valid (and unchanged) for as long as it is held. It
+ * owns a hazard slot of the thread that read it and may be moved to, and dropped by, any other thread.
+ * Meant for scoped reads: every snapshot alive pins a slot, and each one makes every retire() scan longer.
+ * Whoever keeps a version beyond the scope, e.g. for an asynchronous call, should make T a shared_ptr and
+ * copy it out.
+ */
+template<typename T>
+class Snapshot
+{
+public:
+    Snapshot() = default;
+
+    Snapshot(const Snapshot &) = delete;
+    Snapshot(Snapshot && other) noexcept :
+        m_value(std::exchange(other.m_value, nullptr)), m_slot(std::exchange(other.m_slot, nullptr))
+    {}
+
+    Snapshot & operator=(Snapshot other) noexcept
+    {
+        std::swap(m_value, other.m_value);
+        std::swap(m_slot, other.m_slot);
+        return *this;
+    }
+
+    ~Snapshot()
+    {
+        if(m_slot != nullptr)
+            m_slot->store(nullptr, std::memory_order_release);
+    }
+
+    const T & operator*() const { return *m_value; }
+    const T * operator->() const { return m_value; }
+    explicit  operator bool() const { return m_value != nullptr; }
+
+private:
+    friend class CopyOnWrite<T>;
+
+    Snapshot(const T * value, std::atomic<const void *> * slot) : m_value(value), m_slot(slot) {}
+
+    const T *                   m_value = nullptr;
+    std::atomic<const void *> * m_slot  = nullptr;
+};
+
+/**
+ * RCU style cell for data that is read far more often than it changes. read() never blocks and writes no
+ * shared counter: it publishes the current version in a hazard slot of the calling thread and checks that
+ * it is still current. update() copies the current version, modifies the copy and publishes it with one
+ * atomic exchange; the old version is retired and deleted once no snapshot holds it, the writer never
+ * waits for readers. Writers pay the copy and must be serialized by the owner.
+ */
+template<typename T>
+class CopyOnWrite
+{
+public:
+    template<typename... Args>
+    explicit CopyOnWrite(Args &&... args) : m_current(new T(std::forward<Args>(args)...))
+    {}
+
+    CopyOnWrite(const CopyOnWrite &) = delete;
+    CopyOnWrite & operator=(const CopyOnWrite &) = delete;
+
+    /// Snapshots of the last version may outlive the cell
+    ~CopyOnWrite() { retire(m_current.load(std::memory_order_relaxed)); }
+
+    Snapshot<T> read() const
+    {
+        std::atomic<const void *> & slot = detail::HazardDomain::instance().acquire_slot();
+
+        // Sequentially consistent with the exchange and the slot scan of a writer: either the writer sees
+        // the slot, or the reload here sees the new version and protects that one instead
+        const T * value = m_current.load();
+        for(;;)
+        {
+            slot.store(value);
+            const T * current = m_current.load();
+            if(current == value)
+                break;
+            value = current;
+        }
+
+        return Snapshot<T>(value, &slot);
+    }
+
+    /// fn(T &) modifies a private copy of the current value, readers see all of its changes at once
+    template<typename Function>
+    void update(Function && fn)
+    {
+        auto copy = std::make_unique<T>(*m_current.load(std::memory_order_relaxed));
+        fn(*copy);
+        publish(copy.release());
+    }
+
+    /// Replaces the value as a whole, for writers that keep the master copy themselves
+    void store(T value) { publish(new T(std::move(value))); }
+
+private:
+    void publish(T * value) { retire(m_current.exchange(value)); }
+
+    static void retire(const T * value)
+    {
+        detail::HazardDomain::instance().retire(value,
+                                                [](const void * p) { delete static_cast<const T *>(p); });
+    }
+
+    std::atomic<T *> m_current;
+};
+}   // namespace evnt
+
+#endif   // COPYONWRITE_H
@@ -2,6 +2,8 @@
 #include "../log/log.h"
 #include <boost/property_tree/json_parser.hpp>
 #include <chrono>
+#include <sstream>
+#include <thread>
 
 namespace evnt
 {
@@ -13,15 +15,95 @@ int64_t GetMilisecFromStart()
         .count();
 }
 
-Core::Core()
+// "0-3,8,10-11" -> {0, 1, 2, 3, 8, 10, 11}
+static std::vector<int> ParseCpuList(const std::string & list)
 {
-    m_thread_pool  = std::make_unique<ThreadPool>();
-    m_event_system = std::make_unique<EventSystem>(*m_thread_pool);
+    std::vector<int>   res;
+    std::istringstream ss(list);
+    std::string        range;
+    while(std::getline(ss, range, ','))
+    {
+        if(range.empty())
+            continue;
+
+        const auto dash  = range.find('-');
+        const int  first = std::stoi(range.substr(0, dash));
+        const int  last  = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+        for(int cpu = first; cpu <= last; ++cpu)
+            res.push_back(cpu);
+    }
+
+    return res;
+}
+
+static PoolConfig ReadPoolConfig(const pt::ptree & root, const std::string & path)
+{
+    PoolConfig res;
 
+    auto config = root.get_child_optional(path);
+    if(!config)
+        return res;
+
+    res.num_threads     = config->get<std::size_t>("Size", 0);
+    res.backend         = config->get<std::string>("Backend", "io_service") == "work_stealing"
+                              ? PoolBackend::work_stealing
+                              : PoolBackend::io_service;
+    res.pin_each_worker = config->get<bool>("PinEachWorker", false);
+    res.max_threads     = config->get<std::size_t>("MaxSize", 0);
+    res.grow_latency    = std::chrono::milliseconds(config->get<int64_t>("GrowLatencyMs", 2));
+    res.idle_timeout    = std::chrono::milliseconds(config->get<int64_t>("IdleTimeoutMs", 5000));
+    res.queue_capacity  = config->get<std::size_t>("QueueCapacity", 0);
+    res.overflow        = config->get<std::string>("OverflowPolicy", "block") == "run_on_caller"
+                              ? OverflowPolicy::run_on_caller
+                              : OverflowPolicy::block;
+
+    if(auto nodes = config->get_child_optional("NumaNodes"))
+    {
+        for(const auto & node : *nodes)
+            res.node_cpus.push_back(ParseCpuList(node.second.get<std::string>("Cpus")));
+    }
+
+    return res;
+}
+
+static void DrainPool(ThreadPool & pool, const pt::ptree & root, const std::string & path)
+{
+    const auto  timeout = std::chrono::milliseconds(root.get<int64_t>(path + ".DrainTimeoutMs", 2000));
+    DrainReport report  = pool.drain(timeout);
+    if(report.completed && report.num_dropped == 0 && report.num_timers_dropped == 0)
+        return;
+
+    Log::Log(Log::warning,
+             Log::cstr_log("%s drained in %lld ms: %zu tasks completed, %zu dropped, %zu timers dropped, "
+                           "%zu still running",
+                           path.c_str(), static_cast<long long>(timeout.count()), report.num_completed,
+                           report.num_dropped, report.num_timers_dropped, report.num_running));
+}
+
+void Core::onShutDown()
+{
+    // Blocking work first, its continuations may still hand follow-up work to the compute pool
+    DrainPool(*m_io_pool, m_root_config, "BaseConfig.IoThreadPool");
+    DrainPool(*m_thread_pool, m_root_config, "BaseConfig.ThreadPool");
+}
+
+Core::Core()
+{
     // http://techgate.fr/boost-property-tree/
     // Load the config.json file in this ptree
     pt::read_json("config.json", m_root_config);
 
+    m_thread_pool = std::make_unique<ThreadPool>(ReadPoolConfig(m_root_config, "BaseConfig.ThreadPool"));
+
+    // Blocking calls spend their time in syscalls, the I/O pool is oversubscribed on purpose
+    PoolConfig io_config = ReadPoolConfig(m_root_config, "BaseConfig.IoThreadPool");
+    io_config.backend    = PoolBackend::io_service;
+    if(io_config.num_threads == 0)
+        io_config.num_threads = std::max(4u, 2 * std::thread::hardware_concurrency());
+    m_io_pool = std::make_unique<ThreadPool>(io_config);
+
+    m_event_system = std::make_unique<EventSystem>(*m_thread_pool);
+
     m_file_system = std::make_unique<FileSystem>(
         m_root_config.get<std::string>("BaseConfig.FileSystem.RootPathRelative"));
 
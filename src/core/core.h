@@ -19,6 +19,7 @@ class Core : public Module<Core>
 {
     pt::ptree                    m_root_config;
     std::unique_ptr<ThreadPool>  m_thread_pool;
+    std::unique_ptr<ThreadPool>  m_io_pool;
     std::unique_ptr<EventSystem> m_event_system;
     std::unique_ptr<FileSystem>  m_file_system;
 
@@ -27,6 +28,9 @@ public:
 
     ~Core() = default;
 
+    /// Called by Core::shutDown(), drains the pools within DrainTimeoutMs and logs what had to be dropped
+    void onShutDown() override;
+
     // Events
     template<typename EventTrait>
     void registerEvent()
@@ -35,9 +39,16 @@ public:
     }
 
     template<typename EventTrait>
-    EvntHandle addFunctor(typename EventTrait::DelegateType fn)
+    EvntHandle addFunctor(typename EventTrait::DelegateType fn,
+                          HandlerAffinity               affinity = HandlerAffinity::any_worker)
+    {
+        return m_event_system->subscribeToEvent<EventTrait>(std::move(fn), affinity);
+    }
+
+    template<typename EventTrait>
+    EvntHandle addFunctor(typename EventTrait::DelegateType fn, Executor & executor)
     {
-        return m_event_system->subscribeToEvent<EventTrait>(std::move(fn));
+        return m_event_system->subscribeToEvent<EventTrait>(std::move(fn), executor);
     }
 
     template<typename EventTrait>
@@ -54,8 +65,61 @@ public:
         return m_event_system->raiseEvent<EventTrait>(std::forward<Args>(args)...);
     }
 
+    template<typename EventTrait, typename... Args>
+    auto raiseEvent(DispatchPolicy policy, Args &&... args)
+    {
+        static_assert(EventTrait::numArgs == sizeof...(Args), "Incorrect arguments number!");
+
+        return m_event_system->raiseEvent<EventTrait>(policy, std::forward<Args>(args)...);
+    }
+
+    /// One raise for many payloads, see EventSystem::raiseEventBatch()
+    template<typename EventTrait, typename... Args>
+    Future<void> raiseEventBatch(Args &&... args)
+    {
+        return m_event_system->raiseEventBatch<EventTrait>(std::forward<Args>(args)...);
+    }
+
+    template<typename EventTrait>
+    EvntHandle addBatchFunctor(BatchDelegate<EventTrait> fn,
+                               HandlerAffinity           affinity = HandlerAffinity::any_worker)
+    {
+        return m_event_system->subscribeToEventBatch<EventTrait>(std::move(fn), affinity);
+    }
+
+    template<typename EventTrait, typename... Args>
+    void queueEvent(Args &&... args)
+    {
+        m_event_system->queueEvent<EventTrait>(std::forward<Args>(args)...);
+    }
+
+    template<typename EventTrait, typename KeyFunction>
+    void setEventCoalescing(KeyFunction && key_of)
+    {
+        m_event_system->setEventCoalescing<EventTrait>(std::forward<KeyFunction>(key_of));
+    }
+
+    /// Once per frame, raises the events queued with queueEvent()
+    std::size_t flushEvents() { return m_event_system->flushEvents(); }
+
+    /// Once per frame on the main thread, runs the delegates subscribed with HandlerAffinity::main_thread
+    std::size_t pumpMainThread() { return m_event_system->pumpMainThread(); }
+
+    /**
+     * Blocking calls (file reads, UDPSocket::receiveFrom, ...) belong on the I/O pool, so the compute workers
+     * of getThreadPool() are never parked in syscalls. Continuations attached with then() run on the I/O
+     * pool too, hand CPU-bound follow-up work back with getThreadPool().async().
+     */
+    template<typename FunctionType>
+    auto runBlocking(FunctionType && f)
+    {
+        return m_io_pool->async(std::forward<FunctionType>(f));
+    }
+
     // getters
     ThreadPool &      getThreadPool() { return *m_thread_pool; }
+    ThreadPool &      getIoPool() { return *m_io_pool; }   // io_service backend, also runs socket completions
+    EventSystem &     getEventSystem() { return *m_event_system; }   // recording, see EventReplayer
     FileSystem &      getFileSystem() { return *m_file_system; }
     const pt::ptree & getRootConfig() const { return m_root_config; }
 };
@@ -0,0 +1,263 @@
+#ifndef CORO_H
+#define CORO_H
+
+// C++20 coroutine support, enabled with CONFIG+=coroutines in the project file
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#define EVNT_HAS_COROUTINES 1
+
+#include "executor.h"
+#include "future.h"
+
+#include <coroutine>
+#include <exception>
+#include <utility>
+#include <variant>
+
+namespace evnt
+{
+template<typename T = void>
+class Task;
+
+namespace detail
+{
+    template<typename T>
+    class TaskPromiseBase
+    {
+    public:
+        std::suspend_always initial_suspend() noexcept { return {}; }
+
+        /// Resume whoever awaited the task (symmetric transfer, no stack growth)
+        auto final_suspend() noexcept
+        {
+            struct FinalAwaiter
+            {
+                bool await_ready() noexcept { return false; }
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<>) noexcept
+                {
+                    return continuation;
+                }
+                void await_resume() noexcept {}
+
+                std::coroutine_handle<> continuation;
+            };
+
+            return FinalAwaiter{m_continuation ? m_continuation : std::noop_coroutine()};
+        }
+
+        void unhandled_exception() { m_result.template emplace<2>(std::current_exception()); }
+
+        void set_continuation(std::coroutine_handle<> continuation) { m_continuation = continuation; }
+
+        stored_type<T> take_result()
+        {
+            if(m_result.index() == 2)
+                std::rethrow_exception(std::get<2>(m_result));
+
+            return std::move(std::get<1>(m_result));
+        }
+
+    protected:
+        std::variant<std::monostate, stored_type<T>, std::exception_ptr> m_result;
+        std::coroutine_handle<>                                          m_continuation;
+    };
+
+    template<typename T>
+    class TaskPromise : public TaskPromiseBase<T>
+    {
+    public:
+        Task<T> get_return_object();
+
+        template<typename U>
+        void return_value(U && value)
+        {
+            this->m_result.template emplace<1>(std::forward<U>(value));
+        }
+    };
+
+    template<>
+    class TaskPromise<void> : public TaskPromiseBase<void>
+    {
+    public:
+        Task<void> get_return_object();
+
+        void return_void() { m_result.emplace<1>(); }
+    };
+
+    /// Eagerly started, self-destroying coroutine used to drive a Task from non-coroutine code
+    struct DetachedTask
+    {
+        struct promise_type
+        {
+            DetachedTask       get_return_object() { return {}; }
+            std::suspend_never initial_suspend() noexcept { return {}; }
+            std::suspend_never final_suspend() noexcept { return {}; }
+            void               return_void() {}
+            void               unhandled_exception() { std::terminate(); }
+        };
+    };
+}   // namespace detail
+
+/**
+ * Lazily started coroutine. It runs when it is co_await-ed (or handed to spawn()), and resumes its awaiter
+ * when it finishes. A suspended Task holds no thread: it continues on whatever thread completes the thing
+ * it waits for - a pool worker after co_await pool.schedule(), the io thread after a network receive.
+ */
+template<typename T>
+class Task
+{
+public:
+    using promise_type = detail::TaskPromise<T>;
+    using handle_type  = std::coroutine_handle<promise_type>;
+
+    Task(Task && other) noexcept : m_handle(std::exchange(other.m_handle, nullptr)) {}
+    Task & operator=(Task && other) noexcept
+    {
+        if(this != &other)
+        {
+            if(m_handle)
+                m_handle.destroy();
+            m_handle = std::exchange(other.m_handle, nullptr);
+        }
+
+        return *this;
+    }
+
+    Task(const Task &) = delete;
+    Task & operator=(const Task &) = delete;
+
+    ~Task()
+    {
+        if(m_handle)
+            m_handle.destroy();
+    }
+
+    auto operator co_await() && noexcept
+    {
+        struct Awaiter
+        {
+            bool await_ready() noexcept { return false; }
+
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+            {
+                handle.promise().set_continuation(awaiting);
+                return handle;
+            }
+
+            T await_resume()
+            {
+                if constexpr(std::is_void<T>::value)
+                    handle.promise().take_result();
+                else
+                    return handle.promise().take_result();
+            }
+
+            handle_type handle;
+        };
+
+        return Awaiter{m_handle};
+    }
+
+private:
+    friend class detail::TaskPromise<T>;
+
+    explicit Task(handle_type handle) : m_handle(handle) {}
+
+    handle_type m_handle;
+};
+
+namespace detail
+{
+    template<typename T>
+    Task<T> TaskPromise<T>::get_return_object()
+    {
+        return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+    }
+
+    inline Task<void> TaskPromise<void>::get_return_object()
+    {
+        return Task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+    }
+
+    template<typename T>
+    DetachedTask drive(Task<T> task, Promise<T> promise)
+    {
+        try
+        {
+            if constexpr(std::is_void<T>::value)
+            {
+                co_await std::move(task);
+                promise.set_value();
+            }
+            else
+            {
+                promise.set_value(co_await std::move(task));
+            }
+        }
+        catch(...)
+        {
+            promise.set_exception(std::current_exception());
+        }
+    }
+}   // namespace detail
+
+/// Start a Task from ordinary code, it runs on the calling thread until its first suspension
+template<typename T>
+Future<T> spawn(Task<T> task)
+{
+    Promise<T> promise;
+    Future<T>  res = promise.get_future();
+    detail::drive(std::move(task), std::move(promise));
+
+    return res;
+}
+
+/// co_await executor.schedule() continues the coroutine on one of the executor's threads
+class ScheduleAwaiter
+{
+public:
+    ScheduleAwaiter(Executor & executor, TaskPriority priority) :
+        m_executor(executor), m_priority(priority)
+    {}
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> h) { m_executor.execute(m_priority, [h] { h.resume(); }); }
+    void await_resume() const noexcept {}
+
+private:
+    Executor &   m_executor;
+    TaskPriority m_priority;
+};
+
+/// Any Future can be co_await-ed: the coroutine resumes on the thread that completes it
+template<typename T>
+auto operator co_await(Future<T> && future)
+{
+    struct Awaiter
+    {
+        bool await_ready() const { return future.is_ready(); }
+
+        void await_suspend(std::coroutine_handle<> h)
+        {
+            // May resume (and finish) the coroutine right here, nothing of *this is used afterwards
+            detail::state_ptr<T> state = get_state(future);
+            state->on_ready([h] { h.resume(); });
+        }
+
+        T await_resume() { return future.get(); }
+
+        Future<T> future;
+    };
+
+    return Awaiter{std::move(future)};
+}
+
+template<typename T>
+auto operator co_await(Future<T> & future)
+{
+    return operator co_await(std::move(future));
+}
+}   // namespace evnt
+
+#endif   // __cpp_impl_coroutine
+
+#endif   // CORO_H
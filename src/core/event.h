@@ -1,54 +1,155 @@
 #ifndef EVENT_H
 #define EVENT_H
 
+#include "adaptive_lock.h"
+#include "copy_on_write.h"
+#include "event_recorder.h"
+#include "slot_map.h"
+#include "span.h"
+#include "task_inbox.h"
 #include "threadpool.h"
 
 #include <algorithm>
 #include <atomic>
+#include <cassert>
+#include <cstdint>
 #include <functional>
-#include <list>
 #include <memory>
+#include <optional>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 
-#define DECLARE_EVENT_TRAIT(eventTrait, result, ...)                                                   \
+#define DECLARE_EVENT_TRAIT(eventTrait, result, ...) \
+    DECLARE_EVENT_TRAIT_DISPATCH(eventTrait, parallel, result, __VA_ARGS__)
+
+/**
+ * Same as DECLARE_EVENT_TRAIT, with the DispatchPolicy raiseEvent() uses for the event by default. The id
+ * hashes the namespace qualified name of the trait and its signature, equal names in different namespaces
+ * get different ids.
+ */
+#define DECLARE_EVENT_TRAIT_DISPATCH(eventTrait, policy, result, ...)                                  \
     struct eventTrait                                                                                  \
     {                                                                                                  \
         typedef std::tuple<__VA_ARGS__>                 ParamsTuple;                                   \
         typedef result                                  result_type;                                   \
         typedef std::function<result_type(__VA_ARGS__)> DelegateType;                                  \
         static const std::size_t                        numArgs = std::tuple_size<ParamsTuple>::value; \
-        static const char *                             name() { return #eventTrait; }                 \
+        static constexpr evnt::DispatchPolicy           dispatch = evnt::DispatchPolicy::policy;       \
+        static constexpr std::uint64_t                  id       = evnt::fnv1a_hash(                   \
+            #result "(" #__VA_ARGS__ ")", evnt::fnv1a_hash(EVNT_QUALIFIED_SCOPE));                     \
+        static constexpr const char *                   name() { return #eventTrait; }                 \
     };
 
+/// Qualified name of the class the macro is expanded in, as a constant expression
+#ifdef _MSC_VER
+#    define EVNT_QUALIFIED_SCOPE [] { return __FUNCSIG__; }()
+#else
+#    define EVNT_QUALIFIED_SCOPE [] { return __PRETTY_FUNCTION__; }()
+#endif
+
 namespace evnt
 {
+/// 64-bit FNV-1a of a zero terminated string, usable in constant expressions. Chained through hash
+constexpr std::uint64_t fnv1a_hash(const char * str, std::uint64_t hash = 14695981039346656037ull)
+{
+    for(; *str != '\0'; ++str)
+        hash = (hash ^ static_cast<unsigned char>(*str)) * 1099511628211ull;
+
+    return hash;
+}
+
+/// How raiseEvent() runs the delegates of one call
+enum class DispatchPolicy
+{
+    parallel,        // one pool task per delegate, for handlers that do real work
+    run_on_caller,   // one after another on the raising thread, the result is ready on return
+    batched          // one after another in a single pool task, tiny handlers off the raising thread
+};
+
+/**
+ * Where the delegate of a subscription runs. A delegate bound to its own executor instead (e.g. a
+ * SerialExecutor over the pool, as a dedicated worker) is always sent there, whatever the policy.
+ */
+enum class HandlerAffinity
+{
+    any_worker,   // as the DispatchPolicy of the call says
+    main_thread   // queued until the owner of the EventSystem calls pumpMainThread()
+};
+
+/// Results of all delegates of one raiseEvent() call: a vector of values, or just completion for void events
+template<typename EventTrait>
+using event_result_t = std::conditional_t<std::is_void<typename EventTrait::result_type>::value, void,
+                                          std::vector<typename EventTrait::result_type>>;
+
+template<typename EventTrait>
+using EventResult = Future<event_result_t<EventTrait>>;
+
+template<typename EventTrait>
+EventResult<EventTrait> make_empty_event_result()
+{
+    if constexpr(std::is_void<typename EventTrait::result_type>::value)
+        return make_ready_future();
+    else
+        return make_ready_future(event_result_t<EventTrait>());
+}
+
+/// Stable id of the trait, the same in every run of builds by one compiler, see DECLARE_EVENT_TRAIT_DISPATCH
 template<typename T>
-inline std::size_t get_event_trait_hash()
+constexpr std::uint64_t get_event_trait_hash()
 {
-    static std::size_t result = 0;
-    if(!result)
-    {
-        result = std::hash<std::string>{}(std::string(T::name()));
-    }
-    return result;
+    return T::id;
 }
 
-struct FlagLock
+namespace detail
 {
-    FlagLock(std::atomic_bool & f) : m_flag(f)
+    inline std::atomic_size_t         num_event_traits  = {0};
+    inline std::atomic<std::uint64_t> num_event_systems = {0};
+
+    /// uint64_t(const Params &...) for the parameters of a trait
+    template<typename ParamsTuple>
+    struct coalesce_key;
+
+    template<typename... Params>
+    struct coalesce_key<std::tuple<Params...>>
     {
-        while(m_flag.exchange(true))
-            ;
-    }
+        using type = std::function<std::uint64_t(const std::decay_t<Params> &...)>;
+    };
 
-    ~FlagLock() { m_flag.store(false); }
+    template<typename ParamsTuple>
+    struct batch_item;
 
-private:
-    std::atomic_bool & m_flag;
-};
+    template<typename... Params>
+    struct batch_item<std::tuple<Params...>>
+    {
+        using type = std::tuple<std::decay_t<Params>...>;
+    };
 
-using EvntHandle = std::size_t;
+    template<typename Param>
+    struct batch_item<std::tuple<Param>>
+    {
+        using type = std::decay_t<Param>;
+    };
+}   // namespace detail
+
+/// Payload of one event in raiseEventBatch(): the argument itself, a tuple of them for several arguments
+template<typename EventTrait>
+using event_batch_item_t = typename detail::batch_item<typename EventTrait::ParamsTuple>::type;
+
+/// Delegate taking all the payloads of a raise at once
+template<typename EventTrait>
+using BatchDelegate = std::function<void(Span<const event_batch_item_t<EventTrait>>)>;
+
+/// Dense index of the trait in the event table of EventSystem, assigned once on first use
+template<typename T>
+std::size_t get_event_trait_index()
+{
+    static const std::size_t index = detail::num_event_traits++;
+    return index;
+}
+
+/// Generation checked handle of a subscription (SlotMap::handle_type), 0 - not subscribed
+using EvntHandle = std::uint64_t;
 
 struct BasicEvent
 {
@@ -64,51 +165,497 @@ template<typename EventTrait>
 class SpecEvent : public BasicEvent
 {
 public:
-    SpecEvent() : m_access_flag(false) {}
+    SpecEvent() = default;
+
+    /**
+     * bind() appends to the delegate list in place and unbind() clears the alive flag of the entry, both
+     * amortized O(1), and call() never takes the lock. The list is reallocated when it is full or half dead,
+     * copying only the live delegates. A call in flight may still run a delegate that is unbound meanwhile.
+     * A stale or foreign handle is ignored by unbind(). A delegate with an executor is always run by it,
+     * nullptr - by the policy.
+     */
+    EvntHandle bind(typename EventTrait::DelegateType fn, Executor * executor = nullptr)
+    {
+        std::lock_guard<AdaptiveLock> lk(m_access_lock);
+        return append(Delegate{std::move(fn), {}, executor});
+    }
 
-    EvntHandle bind(typename EventTrait::DelegateType fn)
+    /// A batch delegate gets all the payloads of raiseEventBatch() at once, a single raise as one payload
+    EvntHandle bind_batch(BatchDelegate<EventTrait> fn, Executor * executor = nullptr)
     {
-        FlagLock   lk(m_access_flag);
-        EvntHandle evh = ++m_next_available_ID;
-        m_delegates.push_back(DelegateHolder{fn, evh});
+        static_assert(std::is_void<result_type>::value, "Batch delegates are for events without results!");
 
-        return evh;
+        std::lock_guard<AdaptiveLock> lk(m_access_lock);
+        return append(Delegate{{}, std::move(fn), executor});
     }
 
     void unbind(EvntHandle evh)
     {
-        FlagLock lk(m_access_flag);
-        m_delegates.erase(std::remove_if(m_delegates.begin(), m_delegates.end(),
-                                         [evh](const DelegateHolder & d) { return d._object == evh; }),
-                          m_delegates.end());
+        std::lock_guard<AdaptiveLock> lk(m_access_lock);
+        const std::uint32_t *         index = m_slots.find(evh);
+        if(index == nullptr)
+            return;
+
+        Entry & entry = m_list->entries[*index];
+        entry.alive.store(false, std::memory_order_relaxed);
+        if(entry.delegate.executor != nullptr)
+            m_list->num_affine.fetch_sub(1);   // after the flag, see call()
+        m_slots.erase(evh);
+
+        // Copies fewer live entries than unbind() calls since the last reallocation
+        if(++m_list->num_dead * 2 > m_list->size.load(std::memory_order_relaxed))
+            reallocate(m_slots.size() * 2);
     }
 
+    using coalesce_key_function = typename detail::coalesce_key<typename EventTrait::ParamsTuple>::type;
+
+    void set_coalescing(coalesce_key_function key_of)
+    {
+        std::lock_guard<AdaptiveLock> lk(m_access_lock);
+        m_coalesce_key.update([&key_of](coalesce_key_function & fn) { fn = std::move(key_of); });
+    }
+
+    /// Key under which a queued event replaces the earlier ones, empty if the event is not coalesced
     template<typename... Args>
-    auto call(ThreadPool & pool, Args &&... args)
+    std::optional<std::uint64_t> coalesce_key(const Args &... args) const
     {
-        std::vector<std::future<typename EventTrait::result_type>> res;
+        const auto key_of = m_coalesce_key.read();
+        if(!*key_of)
+            return std::nullopt;
+
+        return (*key_of)(args...);
+    }
+
+    /**
+     * Lock-free: runs the delegates bound when the call starts, except those unbound before their turn. The
+     * delegates write their results straight into one shared slot array, a single future covers the whole
+     * call and holds the first exception thrown, if any.
+     *
+     * Pool dispatch copies (or moves) the arguments once into the call context, every delegate task gets
+     * them by reference from there. The context is one block of the BlockPool whatever the number of
+     * delegates, a task captures just a pointer to it. Delegates run concurrently under the parallel
+     * policy, so they must not modify arguments they take by non-const reference.
+     *
+     * Delegates bound to an executor are handed to it first, the policy applies to the others. Such a
+     * call goes through the context even under run_on_caller, its result is ready once they have run.
+     */
+    template<typename... Args>
+    EventResult<EventTrait> call(ThreadPool & pool, DispatchPolicy policy, Args &&... args)
+    {
+        const auto           snapshot  = m_delegates.read();
+        const DelegateList & delegates = **snapshot;
+        const std::size_t    count     = delegates.size.load(std::memory_order_acquire);
+        if(count == 0)
+            return make_empty_event_result<EventTrait>();
+
+        // Read after the size: an affine entry below it has been counted, or unbound before the decrement
+        if(policy == DispatchPolicy::run_on_caller && delegates.num_affine.load() == 0)
         {
-            FlagLock lk(m_access_flag);
-            for(auto & d : m_delegates)
+            CallResults             results(count, &pool);
+            EventResult<EventTrait> res = results.promise.get_future();
+
+            for(std::size_t index = 0; index < count; ++index)
             {
-                std::function<typename EventTrait::result_type()> fn =
-                    std::bind(d._delegate, std::forward<Args>(args)...);
-                res.push_back(pool.submit(fn));
+                const Delegate & d = delegates.entries[index].delegate;
+                if(!delegates.entries[index].alive.load(std::memory_order_relaxed))
+                    results.skip();
+                else
+                    results.run(index, [&d, &args...]() { return call_delegate(d, args...); });
             }
+
+            return res;
         }
+
+        using context_type = CallContext<std::tuple<std::decay_t<Args>...>>;
+
+        // The tasks may outlive this call, they share the list rather than keep the hazard slot
+        auto ctx = std::allocate_shared<context_type>(PoolAllocator<context_type>(), count, &pool, *snapshot,
+                                                      std::forward<Args>(args)...);
+        EventResult<EventTrait> res = ctx->promise.get_future();
+        dispatch(pool, policy, ctx, count);
+
         return res;
     }
 
+    /// Contention of the writer lock: bind(), unbind() and set_coalescing()
+    LockStats lock_stats() const { return m_access_lock.stats(); }
+
+    using batch_item = event_batch_item_t<EventTrait>;
+
+    /**
+     * Every delegate sees all the items: a batch delegate in one call, any other one item after another in
+     * a single task, so a raise costs one future and at most one task per delegate whatever the number of
+     * items. The items are copied once for pool dispatch, or moved in with the vector overload. An exception
+     * stops the delegate that threw, the future holds the first one.
+     */
+    Future<void> call_batch(ThreadPool & pool, DispatchPolicy policy, Span<const batch_item> items)
+    {
+        DelegateListPtr   delegates = *m_delegates.read();
+        const std::size_t count     = delegates->size.load(std::memory_order_acquire);
+        if(count == 0 || items.empty())
+            return make_ready_future();
+
+        if(policy == DispatchPolicy::run_on_caller && delegates->num_affine.load() == 0)
+            return run_batch_on_caller(pool, std::move(delegates), count, items);
+
+        return post_batch(pool, policy, std::move(delegates), count,
+                          std::vector<batch_item>(items.begin(), items.end()));
+    }
+
+    Future<void> call_batch(ThreadPool & pool, DispatchPolicy policy, std::vector<batch_item> && items)
+    {
+        DelegateListPtr   delegates = *m_delegates.read();
+        const std::size_t count     = delegates->size.load(std::memory_order_acquire);
+        if(count == 0 || items.empty())
+            return make_ready_future();
+
+        if(policy == DispatchPolicy::run_on_caller && delegates->num_affine.load() == 0)
+            return run_batch_on_caller(pool, std::move(delegates), count, items);
+
+        return post_batch(pool, policy, std::move(delegates), count, std::move(items));
+    }
+
 private:
-    struct DelegateHolder
+    using result_type = typename EventTrait::result_type;
+
+    struct Delegate
+    {
+        typename EventTrait::DelegateType fn;         // empty for a batch delegate
+        BatchDelegate<EventTrait>         batch;
+        Executor *                        executor;   // nullptr - run as the dispatch policy says
+    };
+
+    /// The delegate never changes once the entry is published, only the flag does
+    struct Entry
+    {
+        Delegate         delegate;
+        EvntHandle       handle = 0;   // of the slot map, for reallocate()
+        std::atomic_bool alive  = {false};
+    };
+
+    /**
+     * Append-only array of the delegates: bind() fills the entry at the published size and then bumps it.
+     * call() reads the size once and skips the dead entries.
+     */
+    struct DelegateList
     {
-        typename EventTrait::DelegateType _delegate;
-        std::size_t                       _object;
+        explicit DelegateList(std::size_t capacity) : entries(new Entry[capacity]), capacity(capacity) {}
+
+        std::unique_ptr<Entry[]> entries;
+        std::size_t              capacity;
+        std::atomic_size_t       size       = {0};
+        std::atomic_size_t       num_affine = {0};   // live entries with an executor, bumped before size
+        std::size_t              num_dead   = 0;     // under m_access_lock
     };
 
-    std::atomic_bool          m_access_flag;
-    std::list<DelegateHolder> m_delegates;
-    mutable uint32_t          m_next_available_ID = {0};
+    /// Held by the contexts of asynchronous calls, which must not pin a hazard slot for their lifetime
+    using DelegateListPtr = std::shared_ptr<const DelegateList>;
+
+    static constexpr std::size_t kMinCapacity = 4;
+
+    /// Under m_access_lock
+    EvntHandle append(Delegate delegate)
+    {
+        if(m_list->size.load(std::memory_order_relaxed) == m_list->capacity)
+            reallocate(m_slots.size() * 2);
+
+        const std::size_t index = m_list->size.load(std::memory_order_relaxed);
+        Entry &           entry = m_list->entries[index];
+        entry.handle            = m_slots.insert(static_cast<std::uint32_t>(index));
+        entry.delegate          = std::move(delegate);
+        entry.alive.store(true, std::memory_order_relaxed);
+        if(entry.delegate.executor != nullptr)
+            m_list->num_affine.fetch_add(1);
+        m_list->size.store(index + 1, std::memory_order_release);
+
+        return entry.handle;
+    }
+
+    /// Under m_access_lock, copies the live entries in order to a new list. Calls in flight keep the old one
+    void reallocate(std::size_t capacity)
+    {
+        auto              list = std::make_shared<DelegateList>(std::max(capacity, kMinCapacity));
+        const std::size_t size = m_list->size.load(std::memory_order_relaxed);
+        std::size_t       live = 0;
+        for(std::size_t index = 0; index < size; ++index)
+        {
+            const Entry & from = m_list->entries[index];
+            if(!from.alive.load(std::memory_order_relaxed))
+                continue;
+
+            Entry & to  = list->entries[live];
+            to.delegate = from.delegate;
+            to.handle   = from.handle;
+            to.alive.store(true, std::memory_order_relaxed);
+            if(to.delegate.executor != nullptr)
+                list->num_affine.fetch_add(1, std::memory_order_relaxed);
+            *m_slots.find(to.handle) = static_cast<std::uint32_t>(live++);
+        }
+        list->size.store(live, std::memory_order_relaxed);
+
+        m_list = std::move(list);
+        m_delegates.store(m_list);
+    }
+
+    /// Results of one call, the last delegate to finish completes the promise
+    struct CallResults
+    {
+        CallResults(std::size_t count, Executor * executor) : remaining(count), promise(executor)
+        {
+            if constexpr(!std::is_void<result_type>::value)
+                results.resize(count);
+        }
+
+        template<typename Function>
+        void run(std::size_t index, Function && fn)
+        {
+            try
+            {
+                if constexpr(std::is_void<result_type>::value)
+                    fn();
+                else
+                    results[index].emplace(fn());
+            }
+            catch(...)
+            {
+                std::lock_guard<std::mutex> lk(mutex);
+                if(!error)
+                    error = std::current_exception();
+            }
+
+            if(--remaining == 0)
+                complete();
+        }
+
+        /// In place of run() for a dead entry, its result is left out
+        void skip()
+        {
+            if(--remaining == 0)
+                complete();
+        }
+
+        void complete()
+        {
+            if(error)
+                promise.set_exception(error);
+            else if constexpr(std::is_void<result_type>::value)
+                promise.set_value();
+            else
+            {
+                std::vector<result_type> values;
+                values.reserve(results.size());
+                for(auto & r : results)
+                {
+                    if(r)
+                        values.push_back(std::move(*r));
+                }
+                promise.set_value(std::move(values));
+            }
+        }
+
+        std::atomic_size_t                                           remaining;
+        std::vector<std::optional<detail::stored_type<result_type>>> results;
+        std::mutex                                                   mutex;
+        std::exception_ptr                                           error;
+        Promise<event_result_t<EventTrait>>                          promise;
+    };
+
+    /// Shared by the pool tasks of one call: its delegates snapshot and the single copy of the arguments
+    template<typename Params>
+    struct CallContext : CallResults
+    {
+        template<typename... Args>
+        CallContext(std::size_t count, Executor * executor, DelegateListPtr list, Args &&... args) :
+            CallResults(count, executor),
+            delegates(std::move(list)),
+            params(std::forward<Args>(args)...)
+        {}
+
+        /// Runs delegate index on the single copy of the arguments, unless it has been unbound meanwhile
+        void invoke(std::size_t index)
+        {
+            const Entry & entry = delegates->entries[index];
+            if(!entry.alive.load(std::memory_order_relaxed))
+                return this->skip();
+
+            this->run(index, [this, &d = entry.delegate]() {
+                return std::apply([&d](auto &... args) { return call_delegate(d, args...); }, params);
+            });
+        }
+
+        DelegateListPtr delegates;
+        Params          params;
+    };
+
+    /// A batch delegate gets the arguments of a single raise as one item
+    template<typename... Args>
+    static result_type call_delegate(const Delegate & d, Args &... args)
+    {
+        if constexpr(std::is_void<result_type>::value)
+        {
+            if(!d.fn)
+            {
+                const auto item = batch_item(args...);
+                return d.batch(Span<const batch_item>(&item, 1));
+            }
+        }
+
+        return d.fn(args...);
+    }
+
+    /// Shared by the tasks of one call_batch(), the items are either owned or the caller's
+    struct BatchContext
+    {
+        BatchContext(std::size_t count, Executor * executor, DelegateListPtr list,
+                     Span<const batch_item> view) :
+            remaining(count), promise(executor), delegates(std::move(list)), items(view)
+        {}
+
+        BatchContext(std::size_t count, Executor * executor, DelegateListPtr list,
+                     std::vector<batch_item> && owned) :
+            remaining(count), promise(executor), delegates(std::move(list)), storage(std::move(owned)),
+            items(storage)
+        {}
+
+        void invoke(std::size_t index)
+        {
+            const Entry & entry = delegates->entries[index];
+            if(!entry.alive.load(std::memory_order_relaxed))
+                return finish();
+
+            const Delegate & d = entry.delegate;
+            try
+            {
+                if(d.batch)
+                    d.batch(items);
+                else
+                {
+                    for(const batch_item & item : items)
+                    {
+                        if constexpr(EventTrait::numArgs == 1)
+                            d.fn(item);
+                        else
+                            std::apply(d.fn, item);
+                    }
+                }
+            }
+            catch(...)
+            {
+                std::lock_guard<std::mutex> lk(mutex);
+                if(!error)
+                    error = std::current_exception();
+            }
+
+            finish();
+        }
+
+        void finish()
+        {
+            if(--remaining == 0)
+            {
+                if(error)
+                    promise.set_exception(error);
+                else
+                    promise.set_value();
+            }
+        }
+
+        std::atomic_size_t      remaining;
+        std::mutex              mutex;
+        std::exception_ptr      error;
+        Promise<void>           promise;
+        DelegateListPtr         delegates;
+        std::vector<batch_item> storage;
+        Span<const batch_item>  items;
+    };
+
+    /// No copy of the items, the delegates are done with them on return
+    static Future<void> run_batch_on_caller(ThreadPool & pool, DelegateListPtr delegates, std::size_t count,
+                                            Span<const batch_item> items)
+    {
+        BatchContext ctx(count, &pool, std::move(delegates), items);
+        Future<void> res = ctx.promise.get_future();
+        for(std::size_t index = 0; index < count; ++index)
+            ctx.invoke(index);
+
+        return res;
+    }
+
+    static Future<void> post_batch(ThreadPool & pool, DispatchPolicy policy, DelegateListPtr delegates,
+                                   std::size_t count, std::vector<batch_item> && items)
+    {
+        auto ctx = std::allocate_shared<BatchContext>(PoolAllocator<BatchContext>(), count, &pool,
+                                                      std::move(delegates), std::move(items));
+        Future<void> res = ctx->promise.get_future();
+        dispatch(pool, policy, ctx, count);
+
+        return res;
+    }
+
+    /**
+     * Affine delegates go to their executor, the others run as the policy says. Every entry below count is
+     * invoked once, a dead one only counts down; it is not worth a task of its own.
+     */
+    template<typename Context>
+    static void dispatch(ThreadPool & pool, DispatchPolicy policy, const std::shared_ptr<Context> & ctx,
+                         std::size_t count)
+    {
+        const Entry * entries    = ctx->delegates->entries.get();
+        std::size_t   num_pooled = 0;
+        for(std::size_t index = 0; index < count; ++index)
+        {
+            Executor * executor = entries[index].delegate.executor;
+            if(executor == nullptr)
+                ++num_pooled;
+            else if(!entries[index].alive.load(std::memory_order_relaxed))
+                ctx->invoke(index);
+            else
+                executor->execute(TaskPriority::critical, [ctx, index]() { ctx->invoke(index); });
+        }
+
+        if(num_pooled == 0)
+            return;
+
+        switch(policy)
+        {
+        case DispatchPolicy::run_on_caller:
+            for(std::size_t index = 0; index < count; ++index)
+            {
+                if(entries[index].delegate.executor == nullptr)
+                    ctx->invoke(index);
+            }
+            break;
+
+        case DispatchPolicy::batched:
+            pool.execute(TaskPriority::critical, [ctx, count]() {
+                for(std::size_t index = 0; index < count; ++index)
+                {
+                    if(ctx->delegates->entries[index].delegate.executor == nullptr)
+                        ctx->invoke(index);
+                }
+            });
+            break;
+
+        case DispatchPolicy::parallel:
+            for(std::size_t index = 0; index < count; ++index)
+            {
+                if(entries[index].delegate.executor != nullptr)
+                    continue;
+
+                if(entries[index].alive.load(std::memory_order_relaxed))
+                    pool.execute(TaskPriority::critical, [ctx, index]() { ctx->invoke(index); });
+                else
+                    ctx->invoke(index);
+            }
+            break;
+        }
+    }
+
+    AdaptiveLock                       m_access_lock;   // serializes writers
+    SlotMap<std::uint32_t>             m_slots;         // handle -> index in m_list, under m_access_lock
+    std::shared_ptr<DelegateList>      m_list{std::make_shared<DelegateList>(kMinCapacity)};   // the same
+    CopyOnWrite<DelegateListPtr>       m_delegates{m_list};   // what call() reads
+    CopyOnWrite<coalesce_key_function> m_coalesce_key;
 };
 
 class EventSystem
@@ -117,77 +664,453 @@ public:
     EventSystem(const EventSystem &) = delete;
     EventSystem & operator=(const EventSystem &) = delete;
 
-    EventSystem(ThreadPool & pool) : m_access_flag(false), m_threadpool(pool) {}
+    EventSystem(ThreadPool & pool) :
+        m_threadpool(pool), m_serial(++detail::num_event_systems)
+    {}
 
     template<typename EventTrait>
     void registerEvent()
     {
-        const std::size_t eventHash = get_event_trait_hash<EventTrait>();
-        FlagLock          lk(m_access_flag);
-        m_events[eventHash] = std::make_unique<SpecEvent<EventTrait>>();
+        const std::size_t             index = get_event_trait_index<EventTrait>();
+        std::lock_guard<AdaptiveLock> lk(m_access_lock);
+
+        // Recording and replay tell the traits apart by id alone
+        const auto id = m_trait_ids.emplace(EventTrait::id, index).first;
+        assert(id->second == index && "Two registered event traits have the same id!");
+        (void)id;
+
+        m_events.update([index](EventsTable & events) {
+            if(events.size() <= index)
+                events.resize(index + 1);
+            events[index] = std::make_shared<SpecEvent<EventTrait>>();
+        });
     }
 
     template<typename EventTrait>
-    EvntHandle subscribeToEvent(typename EventTrait::DelegateType fn)
+    EvntHandle subscribeToEvent(typename EventTrait::DelegateType fn,
+                                HandlerAffinity               affinity = HandlerAffinity::any_worker)
     {
-        FlagLock                lk(m_access_flag);
-        EvntHandle              evh = 0;
-        SpecEvent<EventTrait> * evt = find_spec_event<EventTrait>();
-        if(nullptr != evt)
-        {
-            evh = evt->bind(std::move(fn));
-        }
+        return bind<EventTrait>(std::move(fn),
+                                affinity == HandlerAffinity::main_thread ? &m_main_thread : nullptr);
+    }
 
-        return evh;
+    /// The delegate always runs on executor, which must outlive the subscription and the calls in flight
+    template<typename EventTrait>
+    EvntHandle subscribeToEvent(typename EventTrait::DelegateType fn, Executor & executor)
+    {
+        return bind<EventTrait>(std::move(fn), &executor);
+    }
+
+    /// The delegate takes all the payloads of raiseEventBatch() as one span, see SpecEvent::call_batch()
+    template<typename EventTrait>
+    EvntHandle subscribeToEventBatch(BatchDelegate<EventTrait> fn,
+                                     HandlerAffinity           affinity = HandlerAffinity::any_worker)
+    {
+        return bind_batch<EventTrait>(std::move(fn),
+                                      affinity == HandlerAffinity::main_thread ? &m_main_thread : nullptr);
+    }
+
+    template<typename EventTrait>
+    EvntHandle subscribeToEventBatch(BatchDelegate<EventTrait> fn, Executor & executor)
+    {
+        return bind_batch<EventTrait>(std::move(fn), &executor);
     }
 
     template<typename EventTrait>
     void unSubscribeFromEvent(EvntHandle evh)
     {
-        FlagLock                lk(m_access_flag);
-        SpecEvent<EventTrait> * evt = find_spec_event<EventTrait>();
+        std::lock_guard<AdaptiveLock> lk(m_access_lock);
+        auto                          events = m_events.read();
+        SpecEvent<EventTrait> *       evt    = find_spec_event<EventTrait>(*events);
         if(nullptr != evt)
         {
             evt->unbind(evh);
         }
     }
 
+    /// Contention of the lock serializing registration, subscription and recording changes
+    LockStats lockStats() const { return m_access_lock.stats(); }
+
+    /// Contention of the delegate list lock of the event, empty if it is not registered
+    template<typename EventTrait>
+    LockStats eventLockStats() const
+    {
+        auto                    events = m_events.read();
+        SpecEvent<EventTrait> * evt    = find_spec_event<EventTrait>(*events);
+
+        return nullptr != evt ? evt->lock_stats() : LockStats();
+    }
+
+    /**
+     * Runs the main thread delegates of the calls made so far, on the calling thread - the one that owns
+     * the main loop. A lock-free exchange when there is nothing to run. Returns the number of delegates run.
+     */
+    std::size_t pumpMainThread() { return m_main_thread.pump(); }
+
+    /// Dispatched with the policy of the trait, see DECLARE_EVENT_TRAIT_DISPATCH
     template<typename EventTrait, typename... Args>
-    auto raiseEvent(Args &&... args)
+    EventResult<EventTrait> raiseEvent(Args &&... args)
+    {
+        return raiseEvent<EventTrait>(EventTrait::dispatch, std::forward<Args>(args)...);
+    }
+
+    /// The events and their delegates are read from immutable snapshots, no lock is taken
+    template<typename EventTrait, typename... Args>
+    EventResult<EventTrait> raiseEvent(DispatchPolicy policy, Args &&... args)
+    {
+        if(m_recording.load(std::memory_order_relaxed))
+            record<EventTrait>(args...);
+
+        auto                    events = m_events.read();
+        SpecEvent<EventTrait> * evt    = find_spec_event<EventTrait>(*events);
+        if(nullptr != evt)
+        {
+            return evt->call(m_threadpool, policy, std::forward<Args>(args)...);
+        }
+
+        return make_empty_event_result<EventTrait>();
+    }
+
+    /**
+     * Raises one event per item, for the price of one raise: one future covers the whole batch and each
+     * delegate runs once, a batch delegate on the whole span. Per-item results are not collected.
+     */
+    template<typename EventTrait>
+    Future<void> raiseEventBatch(Span<const event_batch_item_t<EventTrait>> items)
     {
-        std::vector<std::future<typename EventTrait::result_type>> res;
-        FlagLock                                                   lk(m_access_flag);
-        SpecEvent<EventTrait> *                                    evt = find_spec_event<EventTrait>();
+        return raiseEventBatch<EventTrait>(EventTrait::dispatch, items);
+    }
+
+    template<typename EventTrait>
+    Future<void> raiseEventBatch(DispatchPolicy policy, Span<const event_batch_item_t<EventTrait>> items)
+    {
+        if(m_recording.load(std::memory_order_relaxed))
+            record_batch<EventTrait>(items);
+
+        auto                    events = m_events.read();
+        SpecEvent<EventTrait> * evt    = find_spec_event<EventTrait>(*events);
         if(nullptr != evt)
         {
-            res = evt->call(m_threadpool, std::forward<Args>(args)...);
+            return evt->call_batch(m_threadpool, policy, items);
         }
 
-        return res;
+        return make_ready_future();
+    }
+
+    /// Takes the items over instead of copying them when they have to outlive the call
+    template<typename EventTrait>
+    Future<void> raiseEventBatch(std::vector<event_batch_item_t<EventTrait>> && items)
+    {
+        return raiseEventBatch<EventTrait>(EventTrait::dispatch, std::move(items));
+    }
+
+    template<typename EventTrait>
+    Future<void> raiseEventBatch(DispatchPolicy policy, std::vector<event_batch_item_t<EventTrait>> && items)
+    {
+        if(m_recording.load(std::memory_order_relaxed))
+            record_batch<EventTrait>(Span<const event_batch_item_t<EventTrait>>(items));
+
+        auto                    events = m_events.read();
+        SpecEvent<EventTrait> * evt    = find_spec_event<EventTrait>(*events);
+        if(nullptr != evt)
+        {
+            return evt->call_batch(m_threadpool, policy, std::move(items));
+        }
+
+        return make_ready_future();
+    }
+
+    /**
+     * Every event raised from now on, batch items one by one, is logged until stopRecording(). A recording
+     * already running is replaced. Costs one relaxed load per raise while not recording.
+     */
+    std::shared_ptr<EventRecorder> startRecording()
+    {
+        auto recorder = std::make_shared<EventRecorder>();
+
+        std::lock_guard<AdaptiveLock> lk(m_access_lock);
+        m_recorder.store(recorder);
+        m_recording.store(true, std::memory_order_relaxed);
+        return recorder;
+    }
+
+    /// Raises already past the check may still be logged after it returns
+    std::shared_ptr<EventRecorder> stopRecording()
+    {
+        std::lock_guard<AdaptiveLock> lk(m_access_lock);
+        m_recording.store(false, std::memory_order_relaxed);
+        auto recorder = *m_recorder.read();
+        m_recorder.store(nullptr);
+        return recorder;
+    }
+
+    /**
+     * Queued events of the trait collapse per key_of(args...): flushEvents() raises only the last event
+     * queued under each key and drops the earlier ones (last write wins).
+     */
+    template<typename EventTrait, typename KeyFunction>
+    void setEventCoalescing(KeyFunction && key_of)
+    {
+        std::lock_guard<AdaptiveLock> lk(m_access_lock);
+        auto                          events = m_events.read();
+        SpecEvent<EventTrait> *       evt    = find_spec_event<EventTrait>(*events);
+        if(nullptr != evt)
+        {
+            evt->set_coalescing(std::forward<KeyFunction>(key_of));
+        }
+    }
+
+    /**
+     * Deferred raise: the event waits in a buffer of the calling thread until the next flushEvents(), the
+     * arguments are copied (or moved) into it and moved on to the raise. Events of unregistered traits are
+     * dropped right away.
+     */
+    template<typename EventTrait, typename... Args>
+    void queueEvent(Args &&... args)
+    {
+        static_assert(EventTrait::numArgs == sizeof...(Args), "Incorrect arguments number!");
+
+        auto                    events = m_events.read();
+        SpecEvent<EventTrait> * evt    = find_spec_event<EventTrait>(*events);
+        if(nullptr == evt)
+            return;
+
+        const std::optional<std::uint64_t> key = evt->coalesce_key(args...);
+
+        QueuedEvent queued{m_next_sequence++, get_event_trait_index<EventTrait>(), key.has_value(),
+                           key.value_or(0),
+                           [this, params = std::make_tuple(std::forward<Args>(args)...)]() mutable {
+                               // Dispatched once, the raise may take the arguments over
+                               std::apply(
+                                   [this](auto &&... a) {
+                                       raiseEvent<EventTrait>(std::forward<decltype(a)>(a)...);
+                                   },
+                                   std::move(params));
+                           }};
+
+        QueueBuffer &               buffer = local_queue();
+        std::lock_guard<std::mutex> lk(buffer.mutex);
+        buffer.pending.push_back(std::move(queued));
+    }
+
+    /**
+     * Raises everything queued so far by any thread, in queue order and with the trait's dispatch policy,
+     * after coalescing. Events queued meanwhile (by the handlers, too) wait for the next flush. Not to be
+     * called from a handler. Returns the number of events raised.
+     */
+    std::size_t flushEvents()
+    {
+        std::lock_guard<std::mutex> flush_lk(m_flush_mutex);
+
+        std::size_t num_buffers = 0;
+        m_flush_batch.clear();
+        {
+            std::lock_guard<std::mutex> lk(m_buffers_mutex);
+            num_buffers = m_queue_buffers.size();
+            for(auto & buffer : m_queue_buffers)
+            {
+                {
+                    std::lock_guard<std::mutex> buffer_lk(buffer->mutex);
+                    buffer->flushing.swap(buffer->pending);
+                }
+
+                for(auto & queued : buffer->flushing)
+                    m_flush_batch.push_back(&queued);
+            }
+        }
+
+        std::sort(m_flush_batch.begin(), m_flush_batch.end(),
+                  [](const QueuedEvent * a, const QueuedEvent * b) { return a->sequence < b->sequence; });
+
+        // Walking backwards the first event seen under a key is the one that wins
+        m_flush_keys.clear();
+        for(auto it = m_flush_batch.rbegin(); it != m_flush_batch.rend(); ++it)
+        {
+            if((*it)->coalesce && !m_flush_keys.emplace((*it)->trait_index, (*it)->key).second)
+                *it = nullptr;
+        }
+
+        std::size_t num_raised = 0;
+        for(QueuedEvent * queued : m_flush_batch)
+        {
+            if(queued != nullptr)
+            {
+                queued->dispatch();
+                ++num_raised;
+            }
+        }
+
+        // Only the flushing thread touches the flushing buffers, they keep their capacity for the next frame
+        std::lock_guard<std::mutex> lk(m_buffers_mutex);
+        for(std::size_t i = 0; i < num_buffers; ++i)
+            m_queue_buffers[i]->flushing.clear();
+
+        // Buffers of exited threads go once everything they queued has been raised
+        m_queue_buffers.erase(std::remove_if(m_queue_buffers.begin(), m_queue_buffers.end(),
+                                             [](const std::shared_ptr<QueueBuffer> & buffer) {
+                                                 if(!buffer->abandoned.load(std::memory_order_acquire))
+                                                     return false;
+                                                 std::lock_guard<std::mutex> buffer_lk(buffer->mutex);
+                                                 return buffer->pending.empty();
+                                             }),
+                              m_queue_buffers.end());
+
+        return num_raised;
     }
 
 private:
+    struct QueuedEvent
+    {
+        std::uint64_t sequence;   // global queue order
+        std::size_t   trait_index;
+        bool          coalesce;
+        std::uint64_t key;
+        TaskFunction  dispatch;
+    };
+
+    /// Filled by one thread, emptied by flushEvents() - the mutex is practically never contended
+    struct alignas(64) QueueBuffer
+    {
+        std::mutex               mutex;
+        std::vector<QueuedEvent> pending;
+        std::vector<QueuedEvent> flushing;
+        std::atomic_bool         abandoned = {false};   // the thread has exited, flushEvents() drops it
+    };
+
+    /// Shared with the EventSystems the thread queued to, released by whichever side is gone last
+    struct LocalQueues
+    {
+        ~LocalQueues()
+        {
+            for(auto & entry : buffers)
+                entry.second->abandoned.store(true, std::memory_order_release);
+        }
+
+        std::vector<std::pair<std::uint64_t, std::shared_ptr<QueueBuffer>>> buffers;
+    };
+
+    struct CoalesceKeyHash
+    {
+        std::size_t operator()(const std::pair<std::size_t, std::uint64_t> & k) const
+        {
+            return std::hash<std::uint64_t>{}(k.second ^ (k.first * 0x9e3779b97f4a7c15ull));
+        }
+    };
+
+    using coalesce_key_set = std::unordered_set<std::pair<std::size_t, std::uint64_t>, CoalesceKeyHash>;
+
     template<typename EventTrait>
-    SpecEvent<EventTrait> * find_spec_event()
+    EvntHandle bind(typename EventTrait::DelegateType fn, Executor * executor)
     {
-        const std::size_t       eventHash = get_event_trait_hash<EventTrait>();
-        auto                    it        = m_events.find(eventHash);
-        SpecEvent<EventTrait> * ptr       = nullptr;
+        std::lock_guard<AdaptiveLock> lk(m_access_lock);
+        EvntHandle                    evh    = 0;
+        auto                          events = m_events.read();
+        SpecEvent<EventTrait> *       evt    = find_spec_event<EventTrait>(*events);
+        if(nullptr != evt)
+        {
+            evh = evt->bind(std::move(fn), executor);
+        }
 
-        if(it != m_events.end())
+        return evh;
+    }
+
+    template<typename EventTrait, typename... Args>
+    void record(const Args &... args)
+    {
+        const auto recorder = m_recorder.read();
+        if(*recorder)
+            (*recorder)->record<EventTrait>(args...);
+    }
+
+    template<typename EventTrait>
+    void record_batch(Span<const event_batch_item_t<EventTrait>> items)
+    {
+        const auto recorder = m_recorder.read();
+        if(!*recorder)
+            return;
+
+        for(const auto & item : items)
         {
-            ptr = static_cast<SpecEvent<EventTrait> *>(it->second.get());
+            if constexpr(EventTrait::numArgs == 1)
+                (*recorder)->record<EventTrait>(item);
+            else
+                std::apply([&recorder](const auto &... args) { (*recorder)->record<EventTrait>(args...); },
+                           item);
         }
+    }
 
-        return ptr;
+    template<typename EventTrait>
+    EvntHandle bind_batch(BatchDelegate<EventTrait> fn, Executor * executor)
+    {
+        std::lock_guard<AdaptiveLock> lk(m_access_lock);
+        EvntHandle                    evh    = 0;
+        auto                          events = m_events.read();
+        SpecEvent<EventTrait> *       evt    = find_spec_event<EventTrait>(*events);
+        if(nullptr != evt)
+        {
+            evh = evt->bind_batch(std::move(fn), executor);
+        }
+
+        return evh;
+    }
+
+    /// Buffer of the calling thread, created on its first queueEvent()
+    QueueBuffer & local_queue()
+    {
+        // Keyed by the serial, an EventSystem created at the address of a destroyed one is a new system
+        thread_local LocalQueues tls_queues;
+        auto &                   buffers = tls_queues.buffers;
+        for(auto & entry : buffers)
+        {
+            if(entry.first == m_serial)
+                return *entry.second;
+        }
+
+        // Only this thread still holds the buffers of destroyed systems
+        buffers.erase(std::remove_if(buffers.begin(), buffers.end(),
+                                     [](const auto & entry) { return entry.second.use_count() == 1; }),
+                      buffers.end());
+
+        auto buffer = std::make_shared<QueueBuffer>();
+        {
+            std::lock_guard<std::mutex> lk(m_buffers_mutex);
+            m_queue_buffers.push_back(buffer);
+        }
+        buffers.emplace_back(m_serial, buffer);
+        return *buffer;
+    }
+
+    /// Indexed by get_event_trait_index(), empty slots belong to traits not registered here
+    using EventsTable = std::vector<std::shared_ptr<BasicEvent>>;
+
+    template<typename EventTrait>
+    static SpecEvent<EventTrait> * find_spec_event(const EventsTable & events)
+    {
+        const std::size_t index = get_event_trait_index<EventTrait>();
+
+        return index < events.size() ? static_cast<SpecEvent<EventTrait> *>(events[index].get()) : nullptr;
     }
 
 private:
-    using EventsMap = std::unordered_map<std::size_t, std::unique_ptr<BasicEvent>>;
+    AdaptiveLock             m_access_lock;   // serializes writers only
+    CopyOnWrite<EventsTable> m_events;
+    ThreadPool &             m_threadpool;
+    MainThreadExecutor       m_main_thread;   // main thread delegates, see pumpMainThread()
+
+    // EventTrait::id to the trait index, under m_access_lock
+    std::unordered_map<std::uint64_t, std::size_t> m_trait_ids;
+
+    std::atomic_bool                            m_recording = {false};
+    CopyOnWrite<std::shared_ptr<EventRecorder>> m_recorder;
 
-    std::atomic_bool m_access_flag;   // spinlock access
-    EventsMap        m_events;
-    ThreadPool &     m_threadpool;
+    // deferred events, see queueEvent() / flushEvents()
+    const std::uint64_t                       m_serial;
+    std::atomic<std::uint64_t>                m_next_sequence = {0};
+    std::mutex                                m_buffers_mutex;
+    std::vector<std::shared_ptr<QueueBuffer>> m_queue_buffers;
+    std::mutex                                m_flush_mutex;
+    std::vector<QueuedEvent *>                m_flush_batch;
+    coalesce_key_set                          m_flush_keys;
 };
 }   // namespace evnt
 
@@ -0,0 +1,193 @@
+#include "event_recorder.h"
+#include "../fs/file_system.h"
+#include "../log/log.h"
+#include "event_replay.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+namespace evnt
+{
+bool EventRecorder::save(FileSystem & fs, const std::string & path, const std::string & fname) const
+{
+    std::lock_guard<std::mutex> lk(m_mutex);
+
+    return fs.writeFile(path, std::make_unique<MemoryFile>(
+                                  fname, reinterpret_cast<const char *>(m_stream.getBufferPtr()),
+                                  m_stream.getLength()));
+}
+
+bool EventReplayer::load(const FileSystem & fs, const std::string & fname)
+{
+    if(!fs.isExist(fname))
+    {
+        Log::Log(Log::error, Log::cstr_log("EventReplayer::load File: \"%s\" - not found", fname.c_str()));
+        return false;
+    }
+
+    FileSystem::FilePtr file = fs.getFile(fname);
+    auto                data = std::make_unique<int8_t[]>(file->getFileSize());
+    std::memcpy(data.get(), file->getData(), file->getFileSize());
+    InputMemoryStream records(std::move(data), file->getFileSize());
+
+    std::size_t num_events = 0;
+    try
+    {
+        std::uint32_t magic   = 0;
+        std::uint32_t version = 0;
+        records.read(magic);
+        records.read(version);
+        if(magic != EventRecorder::kMagic || version != EventRecorder::kVersion)
+        {
+            Log::Log(Log::error,
+                     Log::cstr_log("EventReplayer::load File: \"%s\" - not an event log", fname.c_str()));
+            return false;
+        }
+
+        while(records.getRemainingDataSize() > 0)
+        {
+            std::uint64_t id   = 0;
+            std::int64_t  time = 0;
+            std::uint32_t size = 0;
+            records.read(id);
+            records.read(time);
+            records.read(size);
+            if(static_cast<std::int64_t>(size) > records.getRemainingDataSize())
+                throw std::range_error("EventReplayer::load - payload past the end");
+
+            records.skip(size);
+            ++num_events;
+        }
+    }
+    catch(const std::range_error &)
+    {
+        Log::Log(Log::error, Log::cstr_log("EventReplayer::load File: \"%s\" - truncated", fname.c_str()));
+        return false;
+    }
+
+    records.resetHead();
+    m_records    = std::move(records);
+    m_num_events = num_events;
+    return true;
+}
+
+namespace detail
+{
+    /// Shared with the completion callbacks, the last one may still be in set_value() when run() returns
+    struct ReplayProgress
+    {
+        explicit ReplayProgress(std::size_t num_events) : latencies(num_events) {}
+
+        void finish_one()
+        {
+            // One extra count while raising, the last delegate to finish after that completes the replay
+            if(--remaining == 0)
+                all_done.set_value();
+        }
+
+        std::atomic_size_t        remaining = {1};
+        Promise<void>             all_done;
+        std::vector<std::int64_t> latencies;
+    };
+}   // namespace detail
+
+// Nearest rank, sorted must not be empty
+static std::chrono::nanoseconds Percentile(const std::vector<std::int64_t> & sorted, double p)
+{
+    const auto rank = static_cast<std::size_t>(std::ceil(p * sorted.size()));
+    return std::chrono::nanoseconds(sorted[std::max<std::size_t>(rank, 1) - 1]);
+}
+
+ReplayReport EventReplayer::run(EventSystem & es, ReplayTiming timing)
+{
+    using clock = std::chrono::steady_clock;
+
+    ReplayReport report;
+    if(m_num_events == 0)
+        return report;
+
+    auto         progress = std::make_shared<detail::ReplayProgress>(m_num_events);
+    Future<void> done     = progress->all_done.get_future();
+
+    m_records.resetHead();
+    m_records.skip(2 * sizeof(std::uint32_t));   // checked by load()
+
+    const auto start = clock::now();
+    while(m_records.getRemainingDataSize() > 0)
+    {
+        std::uint64_t id   = 0;
+        std::int64_t  time = 0;
+        std::uint32_t size = 0;
+        m_records.read(id);
+        m_records.read(time);
+        m_records.read(size);
+
+        if(static_cast<std::int64_t>(size) > m_records.getRemainingDataSize())
+        {
+            Log::Log(Log::error,
+                     Log::cstr_log("EventReplayer::run - event %zu is truncated", report.num_events));
+            break;
+        }
+
+        auto decoder = m_decoders.find(id);
+        if(decoder == m_decoders.end())
+        {
+            m_records.skip(size);
+            ++report.num_skipped;
+            continue;
+        }
+
+        if(timing == ReplayTiming::original)
+            std::this_thread::sleep_until(start + std::chrono::nanoseconds(time));
+
+        const std::size_t index = report.num_events;
+        ++progress->remaining;
+
+        // The decoder checks the arguments against the payload before it raises anything
+        bool       raised_ok = false;
+        const auto raised    = clock::now();
+        try
+        {
+            raised_ok = decoder->second(es, m_records, size, [progress, index, raised]() {
+                progress->latencies[index] = (clock::now() - raised).count();
+                progress->finish_one();
+            });
+        }
+        catch(const std::range_error &)
+        {}
+
+        if(!raised_ok)
+        {
+            --progress->remaining;
+            Log::Log(Log::error,
+                     Log::cstr_log("EventReplayer::run - event %zu does not match its trait", index));
+            break;
+        }
+        report.dispatch_time += clock::now() - raised;
+        ++report.num_events;
+    }
+
+    progress->finish_one();
+    while(done.wait_for(std::chrono::milliseconds(1)) == std::future_status::timeout)
+        es.pumpMainThread();
+    report.total_time = clock::now() - start;
+
+    if(report.num_events == 0)
+        return report;
+
+    std::vector<std::int64_t> & latencies = progress->latencies;
+    latencies.resize(report.num_events);
+    std::sort(latencies.begin(), latencies.end());
+    report.events_per_second =
+        report.num_events / std::max(std::chrono::duration<double>(report.dispatch_time).count(), 1e-9);
+    report.latency_p50 = Percentile(latencies, 0.50);
+    report.latency_p90 = Percentile(latencies, 0.90);
+    report.latency_p99 = Percentile(latencies, 0.99);
+    report.latency_max = std::chrono::nanoseconds(latencies.back());
+
+    return report;
+}
+}   // namespace evnt
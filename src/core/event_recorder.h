@@ -0,0 +1,115 @@
+#ifndef EVENTRECORDER_H
+#define EVENTRECORDER_H
+
+#include "memory_stream.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <type_traits>
+
+namespace evnt
+{
+class FileSystem;
+
+namespace detail
+{
+    /// Argument types OutputMemoryStream / InputMemoryStream can write and read back
+    template<typename T>
+    struct is_recordable
+        : std::integral_constant<bool, std::is_arithmetic<T>::value || std::is_enum<T>::value
+                                           || std::is_same<T, std::string>::value>
+    {};
+
+    template<typename ParamsTuple>
+    struct params_recordable;
+
+    template<typename... Params>
+    struct params_recordable<std::tuple<Params...>>
+        : std::integral_constant<bool, (is_recordable<std::decay_t<Params>>::value && ...)>
+    {};
+
+    /// Written as the parameter type of the trait, so replay reads back what the delegates take
+    template<typename T, typename Arg>
+    void write_param(OutputMemoryStream & out, const Arg & arg)
+    {
+        const T & value = arg;
+        out.write(value);
+    }
+
+    template<typename... Params, typename... Args>
+    void write_params(OutputMemoryStream & out, std::tuple<Params...> *, const Args &... args)
+    {
+        (write_param<std::decay_t<Params>>(out, args), ...);
+    }
+}   // namespace detail
+
+/**
+ * Log of the events raised while recording: per event the trait id, the time since the start of the
+ * recording and the arguments, written with OutputMemoryStream. Only events whose arguments are all
+ * arithmetic, enums or std::string are recorded, the others are counted as skipped. See EventReplayer.
+ *
+ * Layout: kMagic, kVersion, then per event uint64 trait id, int64 ns, uint32 payload size, payload.
+ */
+class EventRecorder
+{
+public:
+    static constexpr std::uint32_t kMagic   = 0x43525645;   // "EVRC"
+    static constexpr std::uint32_t kVersion = 2;   // 2: trait ids hash the qualified name and signature
+
+    EventRecorder() : m_start(std::chrono::steady_clock::now())
+    {
+        m_stream.write(kMagic);
+        m_stream.write(kVersion);
+    }
+
+    template<typename EventTrait, typename... Args>
+    void record(const Args &... args)
+    {
+        using params_tuple = typename EventTrait::ParamsTuple;
+
+        if constexpr(!detail::params_recordable<params_tuple>::value)
+            ++m_num_skipped;
+        else
+        {
+            // Serialized outside the lock, the scratch stream keeps its capacity between events
+            thread_local OutputMemoryStream payload;
+            payload.clear();
+            detail::write_params(payload, static_cast<params_tuple *>(nullptr), args...);
+
+            // Timestamped under the lock, so the log is in time order whatever the number of raisers
+            std::lock_guard<std::mutex> lk(m_mutex);
+            m_stream.write(EventTrait::id);
+            m_stream.write(elapsed_ns());
+            m_stream.write(payload.getLength());
+            m_stream.write(payload.getBufferPtr(), payload.getLength());
+            ++m_num_recorded;
+        }
+    }
+
+    std::size_t numRecorded() const { return m_num_recorded; }
+    std::size_t numSkipped() const { return m_num_skipped; }
+
+    /// Writes the log as fname under path of the file system, stop the recording first
+    bool save(FileSystem & fs, const std::string & path, const std::string & fname) const;
+
+private:
+    std::int64_t elapsed_ns() const
+    {
+        const auto elapsed = std::chrono::steady_clock::now() - m_start;
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+    }
+
+    const std::chrono::steady_clock::time_point m_start;
+
+    mutable std::mutex m_mutex;
+    OutputMemoryStream m_stream;   // under m_mutex
+    std::atomic_size_t m_num_recorded = {0};
+    std::atomic_size_t m_num_skipped  = {0};
+};
+}   // namespace evnt
+
+#endif   // EVENTRECORDER_H
@@ -0,0 +1,100 @@
+#ifndef EVENTREPLAY_H
+#define EVENTREPLAY_H
+
+#include "event.h"
+#include "event_recorder.h"
+
+#include <chrono>
+#include <functional>
+#include <string>
+#include <unordered_map>
+
+namespace evnt
+{
+class FileSystem;
+
+namespace detail
+{
+    template<typename ParamsTuple>
+    struct decayed_params;
+
+    template<typename... Params>
+    struct decayed_params<std::tuple<Params...>>
+    {
+        using type = std::tuple<std::decay_t<Params>...>;
+    };
+}   // namespace detail
+
+enum class ReplayTiming
+{
+    max_speed,   // raise the next event as soon as the previous raise returns
+    original     // keep the intervals of the recording
+};
+
+struct ReplayReport
+{
+    std::size_t              num_events  = 0;   // raised
+    std::size_t              num_skipped = 0;   // of traits not added to the replayer
+    std::chrono::nanoseconds dispatch_time{0};   // spent in the raise calls
+    std::chrono::nanoseconds total_time{0};      // until the last delegate finished
+    double                   events_per_second = 0;   // dispatch throughput: num_events / dispatch_time
+
+    // From the raise to the completion of all the delegates of the event
+    std::chrono::nanoseconds latency_p50{0};
+    std::chrono::nanoseconds latency_p90{0};
+    std::chrono::nanoseconds latency_p99{0};
+    std::chrono::nanoseconds latency_max{0};
+};
+
+/**
+ * Pushes a log written by EventRecorder back through EventSystem::raiseEvent(). The traits to replay are
+ * added with addTrait(), events of the others are skipped.
+ */
+class EventReplayer
+{
+public:
+    template<typename EventTrait>
+    void addTrait()
+    {
+        static_assert(detail::params_recordable<typename EventTrait::ParamsTuple>::value,
+                      "EventRecorder does not record the arguments of this event!");
+
+        m_decoders[EventTrait::id] = [](EventSystem & es, const InputMemoryStream & in, std::uint32_t size,
+                                        TaskFunction done) {
+            const std::int32_t before = in.getRemainingDataSize();
+
+            typename detail::decayed_params<typename EventTrait::ParamsTuple>::type params;
+            std::apply([&in](auto &... args) { (in.read(args), ...); }, params);
+            if(before - in.getRemainingDataSize() != static_cast<std::int32_t>(size))
+                return false;
+
+            auto res = std::apply([&es](auto &... args) { return es.raiseEvent<EventTrait>(args...); },
+                                  params);
+            get_state(res)->on_ready(std::move(done));
+            return true;
+        };
+    }
+
+    /// Reads and checks the log, false if it is missing or malformed
+    bool load(const FileSystem & fs, const std::string & fname);
+
+    std::size_t numEvents() const { return m_num_events; }
+
+    /**
+     * Raises the loaded events in recorded order from the calling thread and waits for their delegates,
+     * running the main thread delegates meanwhile (see EventSystem::pumpMainThread()).
+     */
+    ReplayReport run(EventSystem & es, ReplayTiming timing);
+
+private:
+    /// Reads the arguments and raises the event, false without raising if they do not fill the payload
+    using Decoder =
+        std::function<bool(EventSystem &, const InputMemoryStream &, std::uint32_t size, TaskFunction)>;
+
+    std::unordered_map<std::uint64_t, Decoder> m_decoders;
+    InputMemoryStream                          m_records;
+    std::size_t                                m_num_events = 0;
+};
+}   // namespace evnt
+
+#endif   // EVENTREPLAY_H
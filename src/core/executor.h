@@ -0,0 +1,30 @@
+#ifndef EXECUTOR_H
+#define EXECUTOR_H
+
+#include "task_function.h"
+
+#include <cstddef>
+
+namespace evnt
+{
+/// Queue lanes of the ThreadPool, a worker always takes the task from the most important non-empty lane
+enum class TaskPriority
+{
+    critical,     // latency sensitive work, e.g. event handlers
+    normal,
+    background    // bulk work: compression, serialization
+};
+
+constexpr std::size_t kNumTaskPriorities = 3;
+
+/// Anything that can run a task later: continuations of a Future are scheduled through it
+class Executor
+{
+public:
+    virtual ~Executor() = default;
+
+    virtual void execute(TaskPriority priority, TaskFunction task) = 0;
+};
+}   // namespace evnt
+
+#endif   // EXECUTOR_H
@@ -0,0 +1,458 @@
+#ifndef FUTURE_H
+#define FUTURE_H
+
+#include "cancellation.h"
+#include "executor.h"
+#include "pool_allocator.h"
+#include "task_function.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace evnt
+{
+template<typename T>
+class Future;
+
+template<typename T>
+class Promise;
+
+namespace detail
+{
+    struct Unit
+    {};
+
+    template<typename T>
+    using stored_type = std::conditional_t<std::is_void<T>::value, Unit, T>;
+
+    /**
+     * Shared state of a Promise/Future pair. Callbacks attached with on_ready() run on the thread that
+     * completes the state (or immediately, if it is already complete), they are expected to be short -
+     * the ones created by Future::then() only hand the continuation over to the executor.
+     */
+    template<typename T>
+    class FutureState
+    {
+    public:
+        explicit FutureState(Executor * executor) : m_executor(executor) {}
+
+        Executor * executor() const { return m_executor; }
+        bool       is_ready() const { return m_ready.load(std::memory_order_acquire); }
+        bool       is_cancelled() const { return is_ready() && m_cancelled; }
+
+        template<typename... Args>
+        void set_value(Args &&... args)
+        {
+            std::unique_lock<std::mutex> lk(m_mutex);
+            if(m_ready)
+                throw std::future_error(std::future_errc::promise_already_satisfied);
+
+            m_value.emplace(std::forward<Args>(args)...);
+            complete(lk);
+        }
+
+        void set_exception(std::exception_ptr ex, bool cancelled = false)
+        {
+            std::unique_lock<std::mutex> lk(m_mutex);
+            if(m_ready)
+                throw std::future_error(std::future_errc::promise_already_satisfied);
+
+            m_exception = std::move(ex);
+            m_cancelled = cancelled;
+            complete(lk);
+        }
+
+        void wait() const
+        {
+            if(is_ready())
+                return;
+
+            std::unique_lock<std::mutex> lk(m_mutex);
+            m_cv.wait(lk, [this] { return m_ready.load(); });
+        }
+
+        template<typename Rep, typename Period>
+        bool wait_for(const std::chrono::duration<Rep, Period> & timeout) const
+        {
+            if(is_ready())
+                return true;
+
+            std::unique_lock<std::mutex> lk(m_mutex);
+            return m_cv.wait_for(lk, timeout, [this] { return m_ready.load(); });
+        }
+
+        /// Move the result out of a ready state, rethrows the stored exception
+        stored_type<T> take()
+        {
+            wait();
+            if(m_exception)
+                std::rethrow_exception(m_exception);
+
+            return std::move(*m_value);
+        }
+
+        void on_ready(TaskFunction callback)
+        {
+            {
+                std::lock_guard<std::mutex> lk(m_mutex);
+                if(!m_ready)
+                {
+                    if(!m_callback)
+                        m_callback = std::move(callback);
+                    else
+                        m_extra_callbacks.push_back(std::move(callback));
+                    return;
+                }
+            }
+
+            callback();
+        }
+
+    private:
+        void complete(std::unique_lock<std::mutex> & lk)
+        {
+            m_ready.store(true, std::memory_order_release);
+
+            TaskFunction              callback = std::move(m_callback);
+            std::vector<TaskFunction> extra_callbacks;
+            extra_callbacks.swap(m_extra_callbacks);
+            lk.unlock();
+
+            m_cv.notify_all();
+            if(callback)
+                callback();
+            for(auto & cb : extra_callbacks)
+                cb();
+        }
+
+        Executor *                      m_executor;
+        mutable std::mutex              m_mutex;
+        mutable std::condition_variable m_cv;
+        std::atomic_bool                m_ready = {false};
+        std::optional<stored_type<T>>   m_value;
+        std::exception_ptr              m_exception;
+        bool                            m_cancelled = false;
+        TaskFunction                    m_callback;   // usually there is at most one waiter
+        std::vector<TaskFunction>       m_extra_callbacks;
+    };
+
+    template<typename T>
+    using state_ptr = std::shared_ptr<FutureState<T>>;
+
+    template<typename T>
+    state_ptr<T> make_state(Executor * executor)
+    {
+        return std::allocate_shared<FutureState<T>>(PoolAllocator<FutureState<T>>(), executor);
+    }
+
+    /// Call f with args and store the outcome in the promise-like target
+    template<typename Target, typename FunctionType, typename... Args>
+    void fulfil(Target & target, FunctionType & f, Args &&... args)
+    {
+        using result_type = std::invoke_result_t<FunctionType &, Args...>;
+
+        try
+        {
+            if constexpr(std::is_void<result_type>::value)
+            {
+                f(std::forward<Args>(args)...);
+                target.set_value();
+            }
+            else
+            {
+                target.set_value(f(std::forward<Args>(args)...));
+            }
+        }
+        catch(...)
+        {
+            target.set_exception(std::current_exception());
+        }
+    }
+}   // namespace detail
+
+/**
+ * Single-consumer future with continuations. The result is obtained once with get(); then() consumes the
+ * future and schedules the continuation on the executor of the producer (ThreadPool::async() futures run
+ * their continuations on the same pool), or runs it inline on the completing thread if there is none.
+ */
+template<typename T>
+class Future
+{
+public:
+    using value_type = T;
+
+    Future() = default;
+
+    Future(Future &&) noexcept = default;
+    Future & operator=(Future &&) noexcept = default;
+
+    Future(const Future &) = delete;
+    Future & operator=(const Future &) = delete;
+
+    /// is_ready() and is_cancelled() are false for a future without a state: default, moved from or consumed
+    bool valid() const { return m_state != nullptr; }
+    bool is_ready() const { return valid() && m_state->is_ready(); }
+    bool is_cancelled() const { return valid() && m_state->is_cancelled(); }   // get() throws TaskCancelled
+    void wait() const { m_state->wait(); }
+
+    template<typename Rep, typename Period>
+    std::future_status wait_for(const std::chrono::duration<Rep, Period> & timeout) const
+    {
+        return m_state->wait_for(timeout) ? std::future_status::ready : std::future_status::timeout;
+    }
+
+    T get()
+    {
+        if(!valid())
+            throw std::future_error(std::future_errc::no_state);
+
+        detail::state_ptr<T> state = std::move(m_state);
+        if constexpr(std::is_void<T>::value)
+            state->take();
+        else
+            return state->take();
+    }
+
+    template<typename FunctionType>
+    auto then(FunctionType && f)
+    {
+        return then(TaskPriority::normal, std::forward<FunctionType>(f));
+    }
+
+    /// f receives the ready Future<T> and may call get() on it (which rethrows a stored exception)
+    template<typename FunctionType>
+    auto then(TaskPriority priority, FunctionType && f)
+    {
+        using result_type = std::invoke_result_t<std::decay_t<FunctionType>, Future<T>>;
+
+        if(!valid())
+            throw std::future_error(std::future_errc::no_state);
+
+        detail::state_ptr<T> state    = std::move(m_state);
+        Executor *           executor = state->executor();
+        auto                 next     = detail::make_state<result_type>(executor);
+        Future<result_type>  res(next);
+
+        detail::FutureState<T> & source = *state;
+        source.on_ready([state = std::move(state), next = std::move(next), executor, priority,
+                         f = std::forward<FunctionType>(f)]() mutable {
+            TaskFunction job = [state = std::move(state), next, f = std::move(f)]() mutable {
+                detail::fulfil(*next, f, Future<T>(std::move(state)));
+            };
+
+            if(executor != nullptr)
+                executor->execute(priority, std::move(job));
+            else
+                job();
+        });
+
+        return res;
+    }
+
+private:
+    template<typename U>
+    friend class Future;
+    template<typename U>
+    friend class Promise;
+    template<typename U>
+    friend const detail::state_ptr<U> & get_state(const Future<U> & f);
+
+    explicit Future(detail::state_ptr<T> state) : m_state(std::move(state)) {}
+
+    detail::state_ptr<T> m_state;
+};
+
+template<typename T>
+const detail::state_ptr<T> & get_state(const Future<T> & f)
+{
+    return f.m_state;
+}
+
+/// Producer side of a Future. Destroying an unsatisfied promise stores broken_promise in the future.
+template<typename T>
+class Promise
+{
+public:
+    explicit Promise(Executor * executor = nullptr) : m_state(detail::make_state<T>(executor)) {}
+
+    Promise(Promise &&) noexcept = default;
+    Promise & operator=(Promise && other) noexcept
+    {
+        abandon();
+        m_state = std::move(other.m_state);
+        return *this;
+    }
+
+    Promise(const Promise &) = delete;
+    Promise & operator=(const Promise &) = delete;
+
+    ~Promise() { abandon(); }
+
+    Future<T> get_future() { return Future<T>(m_state); }
+
+    template<typename... Args>
+    void set_value(Args &&... args)
+    {
+        m_state->set_value(std::forward<Args>(args)...);
+    }
+
+    void set_exception(std::exception_ptr ex) { m_state->set_exception(std::move(ex)); }
+    void set_cancelled() { m_state->set_exception(std::make_exception_ptr(TaskCancelled()), true); }
+
+private:
+    void abandon()
+    {
+        if(m_state && !m_state->is_ready() && m_state.use_count() > 1)
+            m_state->set_exception(
+                std::make_exception_ptr(std::future_error(std::future_errc::broken_promise)));
+    }
+
+    detail::state_ptr<T> m_state;
+};
+
+template<typename T>
+Future<std::decay_t<T>> make_ready_future(T && value)
+{
+    Promise<std::decay_t<T>> promise;
+    promise.set_value(std::forward<T>(value));
+    return promise.get_future();
+}
+
+inline Future<void> make_ready_future()
+{
+    Promise<void> promise;
+    promise.set_value();
+    return promise.get_future();
+}
+
+/**
+ * Ready when every input is ready, the inputs are handed back (ready) in the same order. Continuations of
+ * the result run on the executor of the first input, as do those of the variadic overload.
+ */
+template<typename T>
+Future<std::vector<Future<T>>> when_all(std::vector<Future<T>> futures)
+{
+    struct Context
+    {
+        std::vector<Future<T>>          futures;
+        std::atomic_size_t              remaining = {0};
+        Promise<std::vector<Future<T>>> promise;
+    };
+
+    if(futures.empty())
+        return make_ready_future(std::move(futures));
+
+    std::vector<detail::state_ptr<T>> states;
+    states.reserve(futures.size());
+    for(auto & f : futures)
+        states.push_back(get_state(f));
+
+    auto ctx       = std::make_shared<Context>();
+    ctx->futures   = std::move(futures);
+    ctx->remaining = states.size();
+    ctx->promise   = Promise<std::vector<Future<T>>>(states.front()->executor());
+
+    // The last callback may fire (and move the inputs out) while we are still attaching
+    Future<std::vector<Future<T>>> res = ctx->promise.get_future();
+    for(auto & state : states)
+    {
+        state->on_ready([ctx] {
+            if(--ctx->remaining == 0)
+                ctx->promise.set_value(std::move(ctx->futures));
+        });
+    }
+
+    return res;
+}
+
+template<typename... Ts>
+Future<std::tuple<Future<Ts>...>> when_all(Future<Ts> &&... futures)
+{
+    static_assert(sizeof...(Ts) > 0, "when_all() needs at least one future!");
+
+    struct Context
+    {
+        std::tuple<Future<Ts>...>          futures;
+        std::atomic_size_t                 remaining = {0};
+        Promise<std::tuple<Future<Ts>...>> promise;
+    };
+
+    // Copy the states first, like the vector overload: the last callback moves the inputs out
+    auto states = std::make_tuple(get_state(futures)...);
+
+    auto ctx       = std::make_shared<Context>();
+    ctx->futures   = std::make_tuple(std::move(futures)...);
+    ctx->remaining = sizeof...(Ts);
+    ctx->promise   = Promise<std::tuple<Future<Ts>...>>(std::get<0>(states)->executor());
+
+    Future<std::tuple<Future<Ts>...>> res = ctx->promise.get_future();
+    std::apply(
+        [&ctx](auto &... state) {
+            (state->on_ready([ctx] {
+                if(--ctx->remaining == 0)
+                    ctx->promise.set_value(std::move(ctx->futures));
+            }),
+             ...);
+        },
+        states);
+
+    return res;
+}
+
+template<typename Sequence>
+struct WhenAnyResult
+{
+    std::size_t index;
+    Sequence    futures;
+};
+
+/// Ready as soon as one input is ready, index tells which one
+template<typename T>
+Future<WhenAnyResult<std::vector<Future<T>>>> when_any(std::vector<Future<T>> futures)
+{
+    using result_type = WhenAnyResult<std::vector<Future<T>>>;
+
+    struct Context
+    {
+        std::vector<Future<T>> futures;
+        std::atomic_bool       done = {false};
+        Promise<result_type>   promise;
+    };
+
+    if(futures.empty())
+        return make_ready_future(result_type{static_cast<std::size_t>(-1), std::move(futures)});
+
+    // Copy the states first: the first callback may fire while we are still attaching the others
+    std::vector<detail::state_ptr<T>> states;
+    states.reserve(futures.size());
+    for(auto & f : futures)
+        states.push_back(get_state(f));
+
+    auto ctx     = std::make_shared<Context>();
+    ctx->futures = std::move(futures);
+    ctx->promise = Promise<result_type>(states.front()->executor());
+
+    Future<result_type> res = ctx->promise.get_future();
+    for(std::size_t i = 0; i < states.size(); ++i)
+    {
+        states[i]->on_ready([ctx, i] {
+            if(!ctx->done.exchange(true))
+                ctx->promise.set_value(result_type{i, std::move(ctx->futures)});
+        });
+    }
+
+    return res;
+}
+}   // namespace evnt
+
+#endif   // FUTURE_H
@@ -1,5 +1,6 @@
 #include "gameobjectmanager.h"
 #include "exception.h"
+#include "parallel.h"
 #include <cassert>
 #include <limits>
 #include <iostream>
@@ -98,6 +99,21 @@ void GameObjectManager::dump() const
     }
 }
 
+void GameObjectManager::parallelForEach(ThreadPool & pool, const std::function<void(Object *)> & fn)
+{
+    std::lock_guard<std::mutex> lk(mMutex);
+
+    std::vector<Object *> objects;
+    objects.reserve(mObjects.size());
+    for(const auto & [key, obj_entry]: mObjects)
+    {
+        if(!obj_entry.unique->isDeleted())
+            objects.push_back(obj_entry.unique.get());
+    }
+
+    parallel_for_each(pool, objects.begin(), objects.end(), fn);
+}
+
 void GameObjectManager::serialize(OutputMemoryStream & inMemoryStream) const
 {
     std::lock_guard<std::mutex> lk(mMutex);
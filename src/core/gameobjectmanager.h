@@ -8,6 +8,8 @@
 
 namespace evnt
 {
+class ThreadPool;
+
 class GameObjectManager
 {
     using PUniqueObjPtr = std::unique_ptr<Object>;
@@ -40,6 +42,9 @@ public:
     template<typename type>
     PObjHandle createDefaultObj();
 
+    // fn runs on the pool workers and the calling thread, it must not call back into the manager
+    void parallelForEach(ThreadPool & pool, const std::function<void(Object *)> & fn);
+
     void serialize(OutputMemoryStream & inMemoryStream) const;
     void deserialize(const InputMemoryStream & inMemoryStream, std::vector<PObjHandle> & objects);
     void dump() const;
@@ -13,15 +13,25 @@ void OutputMemoryStream::write(const int8_t * inData, size_t inByteCount)
 
 void InputMemoryStream::read(void * outData, uint32_t inByteCount) const
 {
-    uint32_t resultHead = _head + inByteCount;
-    if(resultHead > _capacity)
+    // _head never passes _capacity, so the difference does not wrap as _head + inByteCount could
+    if(inByteCount > _capacity - _head)
     {
         throw std::range_error("InputMemoryStream::Read - no data to read!");
     }
 
     std::memcpy(outData, _data.get() + _head, inByteCount);
 
-    _head = resultHead;
+    _head += inByteCount;
+}
+
+void InputMemoryStream::skip(uint32_t inByteCount) const
+{
+    if(inByteCount > _capacity - _head)
+    {
+        throw std::range_error("InputMemoryStream::Skip - no data to skip!");
+    }
+
+    _head += inByteCount;
 }
 
 int8_t * InputMemoryStream::getCurPosPtr() const
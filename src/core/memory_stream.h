@@ -16,6 +16,7 @@ class OutputMemoryStream
 public:
     const int8_t * getBufferPtr() const { return _buffer.data(); }
     uint32_t       getLength() const { return _buffer.size(); }
+    void           clear() { _buffer.clear(); }   // keeps the capacity
 
     void write(const int8_t * inData, size_t inByteCount);
 
@@ -70,10 +71,10 @@ public:
         return *this;
     }
 
-    InputMemoryStream(InputMemoryStream && other) : InputMemoryStream() { std::swap(*this, other); }
+    InputMemoryStream(InputMemoryStream && other) : InputMemoryStream() { swap(*this, other); }
     InputMemoryStream & operator=(InputMemoryStream && other)
     {
-        std::swap(*this, other);
+        swap(*this, other);
 
         return *this;
     }
@@ -90,6 +91,7 @@ public:
     int32_t getRemainingDataSize() const { return _capacity - _head; }
 
     void read(void * outData, uint32_t inByteCount) const;
+    void skip(uint32_t inByteCount) const;
 
     template<typename T>
     void read(T & outData) const
@@ -0,0 +1,205 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include "threadpool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+namespace evnt
+{
+namespace detail
+{
+    /// Chunks per participating thread, a little oversubscription evens out uneven chunk costs
+    constexpr std::size_t kChunksPerThread = 4;
+
+    using chunk_function = std::function<void(std::size_t chunk, std::size_t begin, std::size_t end)>;
+
+    inline std::size_t num_chunks_for(const ThreadPool & pool, std::size_t count, std::size_t min_chunk)
+    {
+        const std::size_t max_chunks = (pool.getNumWorkers() + 1) * kChunksPerThread;
+        const std::size_t by_size    = (count + std::max<std::size_t>(min_chunk, 1) - 1)
+                                    / std::max<std::size_t>(min_chunk, 1);
+        return std::max<std::size_t>(1, std::min(max_chunks, by_size));
+    }
+
+    /**
+     * Calls chunk_fn(chunk, begin, end) for every chunk of [0, count). The calling thread takes chunks too
+     * and only waits for chunks other threads have already started, so it never blocks on helper tasks
+     * still sitting in the queue - calling this from inside a pool task is safe.
+     */
+    template<typename ChunkFunction>
+    void for_each_chunk(ThreadPool & pool, std::size_t count, std::size_t num_chunks,
+                        ChunkFunction && chunk_fn)
+    {
+        if(num_chunks <= 1 || pool.getNumWorkers() == 0)
+        {
+            for(std::size_t chunk = 0; chunk < num_chunks; ++chunk)
+                chunk_fn(chunk, count * chunk / num_chunks, count * (chunk + 1) / num_chunks);
+            return;
+        }
+
+        struct Context
+        {
+            std::atomic_size_t      next_chunk  = {0};
+            std::atomic_size_t      done_chunks = {0};
+            std::size_t             num_chunks  = 0;
+            std::size_t             count       = 0;
+            chunk_function *        fn          = nullptr;
+            std::exception_ptr      error;
+            std::mutex              mutex;
+            std::condition_variable cv;
+
+            // fn is only dereferenced for a claimed chunk, the caller outlives all claimed chunks
+            void run()
+            {
+                for(std::size_t chunk = next_chunk++; chunk < num_chunks; chunk = next_chunk++)
+                {
+                    try
+                    {
+                        (*fn)(chunk, count * chunk / num_chunks, count * (chunk + 1) / num_chunks);
+                    }
+                    catch(...)
+                    {
+                        std::lock_guard<std::mutex> lk(mutex);
+                        if(!error)
+                            error = std::current_exception();
+                    }
+
+                    if(++done_chunks == num_chunks)
+                    {
+                        std::lock_guard<std::mutex> lk(mutex);
+                        cv.notify_all();
+                    }
+                }
+            }
+        };
+
+        chunk_function fn = std::ref(chunk_fn);
+
+        auto ctx        = std::make_shared<Context>();
+        ctx->num_chunks = num_chunks;
+        ctx->count      = count;
+        ctx->fn         = &fn;
+
+        const std::size_t num_helpers = std::min(pool.getNumWorkers(), num_chunks - 1);
+        for(std::size_t i = 0; i < num_helpers; ++i)
+            pool.execute(TaskPriority::normal, [ctx] { ctx->run(); });
+
+        ctx->run();
+
+        std::unique_lock<std::mutex> lk(ctx->mutex);
+        ctx->cv.wait(lk, [&ctx] { return ctx->done_chunks == ctx->num_chunks; });
+        if(ctx->error)
+            std::rethrow_exception(ctx->error);
+    }
+}   // namespace detail
+
+/// f(i) for every i in [first, last), the range is split into chunks of at least min_chunk indices
+template<typename Index, typename Function>
+void parallel_for(ThreadPool & pool, Index first, Index last, Function && f, std::size_t min_chunk = 1)
+{
+    if(!(first < last))
+        return;
+
+    const std::size_t count = static_cast<std::size_t>(last - first);
+    detail::for_each_chunk(pool, count, detail::num_chunks_for(pool, count, min_chunk),
+                           [first, &f](std::size_t, std::size_t begin, std::size_t end) {
+                               for(std::size_t i = begin; i < end; ++i)
+                                   f(static_cast<Index>(first + i));
+                           });
+}
+
+/// f(element) for every element of the random access range
+template<typename RandomIt, typename Function>
+void parallel_for_each(ThreadPool & pool, RandomIt first, RandomIt last, Function && f,
+                       std::size_t min_chunk = 1)
+{
+    const std::size_t count = static_cast<std::size_t>(std::distance(first, last));
+    detail::for_each_chunk(pool, count, detail::num_chunks_for(pool, count, min_chunk),
+                           [first, &f](std::size_t, std::size_t begin, std::size_t end) {
+                               std::for_each(first + begin, first + end, f);
+                           });
+}
+
+template<typename RandomIt, typename OutputIt, typename UnaryOperation>
+OutputIt parallel_transform(ThreadPool & pool, RandomIt first, RandomIt last, OutputIt d_first,
+                            UnaryOperation op, std::size_t min_chunk = 1)
+{
+    const std::size_t count = static_cast<std::size_t>(std::distance(first, last));
+    detail::for_each_chunk(pool, count, detail::num_chunks_for(pool, count, min_chunk),
+                           [first, d_first, &op](std::size_t, std::size_t begin, std::size_t end) {
+                               std::transform(first + begin, first + end, d_first + begin, op);
+                           });
+
+    return d_first + count;
+}
+
+/// Chunks are reduced in parallel and combined in order, so op only has to be associative
+template<typename RandomIt, typename T, typename BinaryOperation = std::plus<>>
+T parallel_reduce(ThreadPool & pool, RandomIt first, RandomIt last, T init, BinaryOperation op = {},
+                  std::size_t min_chunk = 1)
+{
+    const std::size_t count      = static_cast<std::size_t>(std::distance(first, last));
+    const std::size_t num_chunks = detail::num_chunks_for(pool, count, min_chunk);
+
+    std::vector<std::optional<T>> partial(num_chunks);
+    detail::for_each_chunk(pool, count, num_chunks,
+                           [first, &op, &partial](std::size_t chunk, std::size_t begin, std::size_t end) {
+                               if(begin == end)
+                                   return;
+
+                               T acc = *(first + begin);
+                               for(std::size_t i = begin + 1; i < end; ++i)
+                                   acc = op(std::move(acc), *(first + i));
+                               partial[chunk] = std::move(acc);
+                           });
+
+    for(auto & p : partial)
+    {
+        if(p)
+            init = op(std::move(init), std::move(*p));
+    }
+
+    return init;
+}
+
+/// Sorts chunks in parallel, then merges neighbouring runs pairwise in parallel rounds
+template<typename RandomIt, typename Compare = std::less<>>
+void parallel_sort(ThreadPool & pool, RandomIt first, RandomIt last, Compare comp = {},
+                   std::size_t min_chunk = 1024)
+{
+    const std::size_t count      = static_cast<std::size_t>(std::distance(first, last));
+    std::size_t       num_chunks = 1;
+    while(num_chunks * 2 <= detail::num_chunks_for(pool, count, min_chunk))
+        num_chunks *= 2;
+
+    auto bound = [count, num_chunks](std::size_t chunk) { return count * chunk / num_chunks; };
+
+    detail::for_each_chunk(pool, count, num_chunks,
+                           [first, &comp](std::size_t, std::size_t begin, std::size_t end) {
+                               std::sort(first + begin, first + end, comp);
+                           });
+
+    for(std::size_t width = 1; width < num_chunks; width *= 2)
+    {
+        const std::size_t num_merges = num_chunks / (2 * width);
+        detail::for_each_chunk(pool, num_merges, num_merges,
+                               [first, &comp, &bound, width](std::size_t merge, std::size_t, std::size_t) {
+                                   const std::size_t lo = 2 * width * merge;
+                                   std::inplace_merge(first + bound(lo), first + bound(lo + width),
+                                                      first + bound(lo + 2 * width), comp);
+                               });
+    }
+}
+}   // namespace evnt
+
+#endif   // PARALLEL_H
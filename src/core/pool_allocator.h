@@ -0,0 +1,187 @@
+#ifndef POOLALLOCATOR_H
+#define POOLALLOCATOR_H
+
+#include <cstddef>
+#include <mutex>
+#include <new>
+
+namespace evnt
+{
+namespace detail
+{
+    /// Number of blocks the current thread had to take from the global allocator
+    inline thread_local std::size_t tls_num_heap_allocations = 0;
+
+    /**
+     * Size-segregated free lists for small, short-lived blocks (future shared states, queued handlers).
+     * Every thread keeps its own cache and exchanges batches of blocks with a global list, so a block may be
+     * allocated on the submitting thread and released on a worker. Blocks are never given back to the
+     * system, the pool keeps the peak number of blocks alive.
+     */
+    class BlockPool
+    {
+    public:
+        static constexpr std::size_t kGranularity  = 16;
+        static constexpr std::size_t kMaxBlockSize = 512;
+        static constexpr std::size_t kNumClasses   = kMaxBlockSize / kGranularity;
+        static constexpr std::size_t kBatchSize    = 32;
+        static constexpr std::size_t kMaxLocal     = 2 * kBatchSize;
+
+        static void * allocate(std::size_t size)
+        {
+            if(size > kMaxBlockSize)
+            {
+                ++tls_num_heap_allocations;
+                return ::operator new(size);
+            }
+
+            const std::size_t cls   = size_class(size);
+            LocalCache &      local = local_cache();
+            if(local.heads[cls] == nullptr && !local.closed)
+                refill(local, cls);
+
+            if(FreeBlock * block = local.heads[cls])
+            {
+                local.heads[cls] = block->next;
+                --local.counts[cls];
+                return block;
+            }
+
+            ++tls_num_heap_allocations;
+            return ::operator new((cls + 1) * kGranularity);
+        }
+
+        static void deallocate(void * ptr, std::size_t size)
+        {
+            if(size > kMaxBlockSize)
+            {
+                ::operator delete(ptr);
+                return;
+            }
+
+            const std::size_t cls   = size_class(size);
+            LocalCache &      local = local_cache();
+            FreeBlock *       block = static_cast<FreeBlock *>(ptr);
+
+            block->next      = local.heads[cls];
+            local.heads[cls] = block;
+            if(++local.counts[cls] > kMaxLocal || local.closed)
+                release(local, cls, local.counts[cls]);
+        }
+
+    private:
+        struct FreeBlock
+        {
+            FreeBlock * next;
+        };
+
+        struct GlobalLists
+        {
+            std::mutex  mutex;
+            FreeBlock * heads[kNumClasses] = {};
+        };
+
+        // Trivially destructible, so it stays usable by other thread_local destructors at thread exit
+        struct LocalCache
+        {
+            FreeBlock * heads[kNumClasses]  = {};
+            std::size_t counts[kNumClasses] = {};
+            bool        closed              = false;
+        };
+
+        struct LocalCacheFlusher
+        {
+            ~LocalCacheFlusher()
+            {
+                LocalCache & local = local_cache();
+                for(std::size_t cls = 0; cls < kNumClasses; ++cls)
+                    release(local, cls, local.counts[cls]);
+
+                local.closed = true;
+            }
+        };
+
+        static std::size_t size_class(std::size_t size) { return size == 0 ? 0 : (size - 1) / kGranularity; }
+
+        static GlobalLists & global_lists()
+        {
+            // Intentionally leaked: thread caches return their blocks here during thread and program exit
+            static GlobalLists * lists = new GlobalLists;
+            return *lists;
+        }
+
+        static LocalCache & local_cache()
+        {
+            static thread_local LocalCache cache;
+            if(!cache.closed)
+            {
+                static thread_local LocalCacheFlusher flusher;
+                (void)flusher;
+            }
+            return cache;
+        }
+
+        static void refill(LocalCache & local, std::size_t cls)
+        {
+            GlobalLists &               global = global_lists();
+            std::lock_guard<std::mutex> lk(global.mutex);
+            for(std::size_t i = 0; i < kBatchSize && global.heads[cls] != nullptr; ++i)
+            {
+                FreeBlock * block = global.heads[cls];
+                global.heads[cls] = block->next;
+                block->next       = local.heads[cls];
+                local.heads[cls]  = block;
+                ++local.counts[cls];
+            }
+        }
+
+        static void release(LocalCache & local, std::size_t cls, std::size_t count)
+        {
+            if(count == 0)
+                return;
+
+            GlobalLists &               global = global_lists();
+            std::lock_guard<std::mutex> lk(global.mutex);
+            for(std::size_t i = 0; i < count && local.heads[cls] != nullptr; ++i)
+            {
+                FreeBlock * block = local.heads[cls];
+                local.heads[cls]  = block->next;
+                block->next       = global.heads[cls];
+                global.heads[cls] = block;
+                --local.counts[cls];
+            }
+        }
+    };
+}   // namespace detail
+
+/// Stateless std-compatible allocator on top of the BlockPool
+template<typename T>
+class PoolAllocator
+{
+public:
+    using value_type = T;
+
+    PoolAllocator() noexcept = default;
+
+    template<typename U>
+    PoolAllocator(const PoolAllocator<U> &) noexcept
+    {}
+
+    T * allocate(std::size_t n) { return static_cast<T *>(detail::BlockPool::allocate(n * sizeof(T))); }
+    void deallocate(T * ptr, std::size_t n) noexcept { detail::BlockPool::deallocate(ptr, n * sizeof(T)); }
+
+    template<typename U>
+    bool operator==(const PoolAllocator<U> &) const noexcept
+    {
+        return true;
+    }
+
+    template<typename U>
+    bool operator!=(const PoolAllocator<U> &) const noexcept
+    {
+        return false;
+    }
+};
+}   // namespace evnt
+
+#endif   // POOLALLOCATOR_H
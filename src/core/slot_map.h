@@ -0,0 +1,115 @@
+#ifndef SLOTMAP_H
+#define SLOTMAP_H
+
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace evnt
+{
+/**
+ * Values in one contiguous array addressed through stable, generation checked handles. insert() and erase()
+ * are O(1): a slot table maps the handle to the dense position, erase() moves the last value into the hole.
+ * A handle whose value has been erased never matches again, even after its slot is reused. Iteration goes
+ * over the dense array, its order changes on erase().
+ */
+template<typename T>
+class SlotMap
+{
+public:
+    /// generation << 32 | slot, 0 is never a valid handle
+    using handle_type = std::uint64_t;
+
+    using iterator       = typename std::vector<T>::iterator;
+    using const_iterator = typename std::vector<T>::const_iterator;
+
+    handle_type insert(T value)
+    {
+        std::uint32_t slot = m_free_head;
+        if(slot == kNone)
+        {
+            slot = static_cast<std::uint32_t>(m_slots.size());
+            m_slots.push_back(Slot{0, 1});
+        }
+        else
+            m_free_head = m_slots[slot].dense;
+
+        m_slots[slot].dense = static_cast<std::uint32_t>(m_values.size());
+        m_values.push_back(std::move(value));
+        m_dense_to_slot.push_back(slot);
+
+        return make_handle(slot, m_slots[slot].generation);
+    }
+
+    /// False for a handle that is stale or was never issued by this map
+    bool erase(handle_type handle)
+    {
+        const std::uint32_t slot = slot_of(handle);
+        if(!contains(handle))
+            return false;
+
+        const std::uint32_t dense = m_slots[slot].dense;
+        const std::uint32_t last  = static_cast<std::uint32_t>(m_values.size() - 1);
+        if(dense != last)
+        {
+            m_values[dense]                       = std::move(m_values[last]);
+            m_dense_to_slot[dense]                = m_dense_to_slot[last];
+            m_slots[m_dense_to_slot[dense]].dense = dense;
+        }
+        m_values.pop_back();
+        m_dense_to_slot.pop_back();
+
+        // Generation 0 would give slot 0 the invalid handle 0, skip it when wrapping
+        if(++m_slots[slot].generation == 0)
+            m_slots[slot].generation = 1;
+        m_slots[slot].dense = m_free_head;
+        m_free_head         = slot;
+        return true;
+    }
+
+    bool contains(handle_type handle) const
+    {
+        const std::uint32_t slot = slot_of(handle);
+        return slot < m_slots.size() && m_slots[slot].generation == generation_of(handle)
+               && m_slots[slot].dense < m_values.size() && m_dense_to_slot[m_slots[slot].dense] == slot;
+    }
+
+    T * find(handle_type handle)
+    {
+        return contains(handle) ? &m_values[m_slots[slot_of(handle)].dense] : nullptr;
+    }
+
+    std::size_t size() const { return m_values.size(); }
+    bool        empty() const { return m_values.empty(); }
+
+    iterator       begin() { return m_values.begin(); }
+    iterator       end() { return m_values.end(); }
+    const_iterator begin() const { return m_values.begin(); }
+    const_iterator end() const { return m_values.end(); }
+
+private:
+    static constexpr std::uint32_t kNone = std::numeric_limits<std::uint32_t>::max();
+
+    struct Slot
+    {
+        std::uint32_t dense;        // position in m_values, the next free slot while the slot is free
+        std::uint32_t generation;   // bumped by every erase
+    };
+
+    static handle_type make_handle(std::uint32_t slot, std::uint32_t generation)
+    {
+        return (handle_type(generation) << 32) | slot;
+    }
+
+    static std::uint32_t slot_of(handle_type handle) { return static_cast<std::uint32_t>(handle); }
+    static std::uint32_t generation_of(handle_type handle) { return std::uint32_t(handle >> 32); }
+
+    std::vector<T>             m_values;
+    std::vector<std::uint32_t> m_dense_to_slot;
+    std::vector<Slot>          m_slots;
+    std::uint32_t              m_free_head = kNone;
+};
+}   // namespace evnt
+
+#endif   // SLOTMAP_H
@@ -0,0 +1,47 @@
+#ifndef SPAN_H
+#define SPAN_H
+
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+namespace evnt
+{
+/// Non-owning view of contiguous elements, the subset of C++20 std::span the tree needs under C++17
+template<typename T>
+class Span
+{
+public:
+    using element_type = T;
+    using iterator     = T *;
+
+    constexpr Span() = default;
+    constexpr Span(T * data, std::size_t size) : m_data(data), m_size(size) {}
+
+    template<std::size_t N>
+    constexpr Span(T (&array)[N]) : m_data(array), m_size(N)
+    {}
+
+    /// Any container with contiguous data() and size(): std::vector, std::array, std::string...
+    template<typename Container,
+             typename = std::enable_if_t<
+                 std::is_convertible<decltype(std::declval<Container &>().data()), T *>::value>>
+    constexpr Span(Container & container) : m_data(container.data()), m_size(container.size())
+    {}
+
+    constexpr T *         data() const { return m_data; }
+    constexpr std::size_t size() const { return m_size; }
+    constexpr bool        empty() const { return m_size == 0; }
+
+    constexpr T & operator[](std::size_t index) const { return m_data[index]; }
+
+    constexpr iterator begin() const { return m_data; }
+    constexpr iterator end() const { return m_data + m_size; }
+
+private:
+    T *         m_data = nullptr;
+    std::size_t m_size = 0;
+};
+}   // namespace evnt
+
+#endif   // SPAN_H
@@ -0,0 +1,150 @@
+#ifndef TASKFUNCTION_H
+#define TASKFUNCTION_H
+
+#include "pool_allocator.h"
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace evnt
+{
+/**
+ * Move-only type-erased void() callable. Callables up to kInlineSize bytes are stored in place, bigger ones
+ * are placed in the BlockPool. Unlike std::function it accepts move-only callables (std::promise,
+ * std::unique_ptr captures) and never copies them.
+ */
+class TaskFunction
+{
+public:
+    static constexpr std::size_t kInlineSize = 64;
+
+    TaskFunction() noexcept = default;
+
+    template<typename F, typename = std::enable_if_t<!std::is_same<std::decay_t<F>, TaskFunction>::value>>
+    TaskFunction(F && f)
+    {
+        using functor_type = std::decay_t<F>;
+
+        if constexpr(fits_inline<functor_type>())
+        {
+            new(&m_storage) functor_type(std::forward<F>(f));
+            m_ops = &inline_ops<functor_type>;
+        }
+        else
+        {
+            void * ptr = detail::BlockPool::allocate(sizeof(functor_type));
+            new(ptr) functor_type(std::forward<F>(f));
+            new(&m_storage) void *(ptr);
+            m_ops = &pooled_ops<functor_type>;
+        }
+    }
+
+    TaskFunction(TaskFunction && other) noexcept : m_ops(other.m_ops)
+    {
+        if(m_ops != nullptr)
+        {
+            m_ops->move(&m_storage, &other.m_storage);
+            other.m_ops = nullptr;
+        }
+    }
+
+    TaskFunction & operator=(TaskFunction && other) noexcept
+    {
+        if(this != &other)
+        {
+            reset();
+            if(other.m_ops != nullptr)
+            {
+                m_ops = other.m_ops;
+                m_ops->move(&m_storage, &other.m_storage);
+                other.m_ops = nullptr;
+            }
+        }
+
+        return *this;
+    }
+
+    TaskFunction(const TaskFunction &) = delete;
+    TaskFunction & operator=(const TaskFunction &) = delete;
+
+    ~TaskFunction() { reset(); }
+
+    explicit operator bool() const noexcept { return m_ops != nullptr; }
+
+    void operator()() { m_ops->invoke(&m_storage); }
+
+    void reset() noexcept
+    {
+        if(m_ops != nullptr)
+        {
+            m_ops->destroy(&m_storage);
+            m_ops = nullptr;
+        }
+    }
+
+private:
+    using storage_type = std::aligned_storage_t<kInlineSize, alignof(std::max_align_t)>;
+
+    struct Ops
+    {
+        void (*invoke)(void *);
+        void (*move)(void * dst, void * src) noexcept;
+        void (*destroy)(void *) noexcept;
+    };
+
+    template<typename T>
+    static constexpr bool fits_inline()
+    {
+        return sizeof(T) <= kInlineSize && alignof(std::max_align_t) % alignof(T) == 0
+               && std::is_nothrow_move_constructible<T>::value;
+    }
+
+    template<typename T>
+    static void inline_invoke(void * s)
+    {
+        (*static_cast<T *>(s))();
+    }
+
+    template<typename T>
+    static void inline_move(void * dst, void * src) noexcept
+    {
+        new(dst) T(std::move(*static_cast<T *>(src)));
+        static_cast<T *>(src)->~T();
+    }
+
+    template<typename T>
+    static void inline_destroy(void * s) noexcept
+    {
+        static_cast<T *>(s)->~T();
+    }
+
+    template<typename T>
+    static void pooled_invoke(void * s)
+    {
+        (**static_cast<T **>(s))();
+    }
+
+    static void pooled_move(void * dst, void * src) noexcept { new(dst) void *(*static_cast<void **>(src)); }
+
+    template<typename T>
+    static void pooled_destroy(void * s) noexcept
+    {
+        T * ptr = *static_cast<T **>(s);
+        ptr->~T();
+        detail::BlockPool::deallocate(ptr, sizeof(T));
+    }
+
+    template<typename T>
+    static constexpr Ops inline_ops = {&inline_invoke<T>, &inline_move<T>, &inline_destroy<T>};
+
+    template<typename T>
+    static constexpr Ops pooled_ops = {&pooled_invoke<T>, &pooled_move, &pooled_destroy<T>};
+
+    storage_type m_storage;
+    const Ops *  m_ops = nullptr;
+};
+}   // namespace evnt
+
+#endif   // TASKFUNCTION_H
@@ -0,0 +1,149 @@
+#ifndef TASKINBOX_H
+#define TASKINBOX_H
+
+#include "executor.h"
+#include "pool_allocator.h"
+#include "task_function.h"
+
+#include <atomic>
+#include <new>
+#include <thread>
+
+namespace evnt
+{
+/**
+ * Lock-free multi-producer, single-consumer task list. push() is one CAS on the head, the consumer takes
+ * everything at once with one exchange and runs it in push order. Nodes come from the BlockPool.
+ */
+class TaskInbox
+{
+public:
+    TaskInbox() = default;
+
+    TaskInbox(const TaskInbox &) = delete;
+    TaskInbox & operator=(const TaskInbox &) = delete;
+
+    ~TaskInbox() { run_nodes(reverse(m_head.exchange(nullptr)), false); }
+
+    void push(TaskFunction task)
+    {
+        Node * node = new(detail::BlockPool::allocate(sizeof(Node))) Node{std::move(task), nullptr};
+        node->next  = m_head.load(std::memory_order_relaxed);
+        while(!m_head.compare_exchange_weak(node->next, node, std::memory_order_release,
+                                            std::memory_order_relaxed))
+        {}
+    }
+
+    /// Consumer only. Runs the tasks pushed so far, oldest first; an exception thrown by a task is dropped
+    std::size_t run_all()
+    {
+        return run_nodes(reverse(m_head.exchange(nullptr, std::memory_order_acquire)), true);
+    }
+
+    bool empty() const { return m_head.load(std::memory_order_acquire) == nullptr; }
+
+private:
+    struct Node
+    {
+        TaskFunction task;
+        Node *       next;
+    };
+
+    static Node * reverse(Node * list)
+    {
+        Node * fifo = nullptr;
+        while(list != nullptr)
+        {
+            Node * next = list->next;
+            list->next  = fifo;
+            fifo        = list;
+            list        = next;
+        }
+
+        return fifo;
+    }
+
+    static std::size_t run_nodes(Node * node, bool run)
+    {
+        std::size_t count = 0;
+        while(node != nullptr)
+        {
+            if(run)
+            {
+                try
+                {
+                    node->task();
+                }
+                catch(...)
+                {}
+            }
+
+            Node * next = node->next;
+            node->~Node();
+            detail::BlockPool::deallocate(node, sizeof(Node));
+            node = next;
+            ++count;
+        }
+
+        return count;
+    }
+
+    std::atomic<Node *> m_head = {nullptr};
+};
+
+/// Tasks wait until the owning thread calls pump(), e.g. once per frame of the main loop
+class MainThreadExecutor : public Executor
+{
+public:
+    void execute(TaskPriority, TaskFunction task) override { m_inbox.push(std::move(task)); }
+
+    /// Runs what has been queued so far, tasks queued by them wait for the next pump()
+    std::size_t pump() { return m_inbox.run_all(); }
+
+private:
+    TaskInbox m_inbox;
+};
+
+/**
+ * Runs its tasks on the target executor one at a time, in submission order - a logical worker thread.
+ * Tasks never overlap, so state they share needs no locking, yet no pool worker is reserved for them.
+ * Must outlive the tasks given to it.
+ */
+class SerialExecutor : public Executor
+{
+public:
+    explicit SerialExecutor(Executor & target) : m_target(target) {}
+
+    void execute(TaskPriority priority, TaskFunction task) override
+    {
+        // Counted before it is pushed: a drain that finds fewer tasks than counted retries
+        const bool idle = m_num_pending.fetch_add(1, std::memory_order_acq_rel) == 0;
+        m_inbox.push(std::move(task));
+        if(idle)
+            m_target.execute(priority, [this] { drain(); });
+    }
+
+private:
+    void drain()
+    {
+        for(;;)
+        {
+            const std::size_t count = m_inbox.run_all();
+            if(count == 0)
+            {
+                std::this_thread::yield();   // a producer is between its count and its push
+                continue;
+            }
+
+            if(m_num_pending.fetch_sub(count, std::memory_order_acq_rel) == count)
+                return;
+        }
+    }
+
+    Executor &         m_target;
+    TaskInbox          m_inbox;
+    std::atomic_size_t m_num_pending = {0};
+};
+}   // namespace evnt
+
+#endif   // TASKINBOX_H
@@ -1,44 +1,388 @@
 #ifndef THREADPOOL_H
 #define THREADPOOL_H
 
+#include "cancellation.h"
+#include "coro.h"
+#include "executor.h"
+#include "future.h"
+#include "pool_allocator.h"
+#include "task_function.h"
+#include "timer_wheel.h"
+#include "work_stealing_queue.h"
+
+#include <array>
 #include <atomic>
 #include <boost/asio.hpp>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
 #include <future>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
 #include <thread>
 #include <vector>
 
+#ifdef __linux__
+#    include <pthread.h>
+#    include <sched.h>
+#endif
+
 namespace evnt
 {
-class ThreadPool
+/// Scheduling backend of the ThreadPool, selected at construction
+enum class PoolBackend
+{
+    io_service,      // all workers share the single boost::asio::io_service queue
+    work_stealing    // per-worker deques, LIFO local pops and random-victim stealing
+};
+
+/// What a producer does when a bounded pool already holds queue_capacity tasks
+enum class OverflowPolicy
+{
+    block,          // wait for a free slot, pool workers themselves run the task inline instead
+    run_on_caller   // run the task inline on the submitting thread
+};
+
+/// Pool size and worker placement, Core fills it from BaseConfig.ThreadPool of config.json
+struct PoolConfig
+{
+    std::size_t                   num_threads     = 0;   // 0 - one less than the number of hardware threads
+    PoolBackend                   backend         = PoolBackend::io_service;
+    std::vector<std::vector<int>> node_cpus;             // CPUs of every NUMA node, empty - no pinning
+    bool                          pin_each_worker = false;   // one CPU per worker instead of the whole node
+
+    // Elastic pool: with max_threads above num_threads workers are added while the average queue wait
+    // exceeds grow_latency, and the extra ones retire after idle_timeout without work
+    std::size_t               max_threads  = 0;
+    std::chrono::milliseconds grow_latency = std::chrono::milliseconds(2);
+    std::chrono::milliseconds idle_timeout = std::chrono::milliseconds(5000);
+
+    // Bounded pool: at most queue_capacity tasks wait in the queues, 0 - unbounded. try_submit() never
+    // waits, it fails on a full queue whatever the policy.
+    std::size_t    queue_capacity = 0;
+    OverflowPolicy overflow       = OverflowPolicy::block;
+};
+
+/// Snapshot returned by ThreadPool::getStats(), the times are totals since construction
+struct PoolStats
 {
+    std::size_t              num_workers;
+    std::size_t              num_busy;   // threads running a task right now
+    std::size_t              num_queued;
+    std::size_t              num_completed;
+    std::size_t              num_workers_added;     // by load, beyond the initial workers
+    std::size_t              num_workers_retired;   // after the idle timeout
+    std::size_t              num_cancelled;         // dropped before they started or gave up while running
+    std::size_t              queue_capacity;        // 0 - unbounded
+    std::size_t              queue_high_water;      // most tasks queued at once
+    std::size_t              num_blocked;           // submissions that waited for a free slot
+    std::size_t              num_ran_on_caller;     // submissions run inline because the queue was full
+    std::size_t              num_rejected;          // try_submit() calls that failed
+    std::chrono::nanoseconds busy_time;             // spent in tasks, summed over the workers
+    std::chrono::nanoseconds worker_time;           // lifetime of the workers, summed
+    std::chrono::nanoseconds queue_wait_time;       // between enqueue and dequeue, summed over the tasks
+
+    double utilization() const
+    {
+        return worker_time.count() > 0
+                   ? std::min(1.0, static_cast<double>(busy_time.count()) / worker_time.count())
+                   : 0.0;
+    }
+};
+
+/// Returned by ThreadPool::drain(), what happened to the work the pool still had
+struct DrainReport
+{
+    bool        completed;            // everything finished before the deadline, nothing was dropped
+    std::size_t num_completed;        // tasks run while draining
+    std::size_t num_dropped;          // queued at the deadline or refused while draining, futures cancelled
+    std::size_t num_timers_dropped;   // timers that had not fired yet
+    std::size_t num_running;          // still running at the deadline, the destructor waits for them
+};
+
+namespace detail
+{
+    struct TimerQueue;
+
+    /// A delayed or periodic task, shared by the timer wheel, the queued run and the TimerHandle
+    struct ScheduledTask
+    {
+        std::chrono::steady_clock::time_point deadline;
+        std::chrono::steady_clock::duration   period;   // zero for a one shot timer
+        TaskPriority                          priority;
+        TaskFunction                          task;
+        std::atomic_bool                      cancelled = {false};
+        std::weak_ptr<TimerQueue>             queue;
+        TimerWheelPosition                    position;   // under queue->mutex
+    };
+}   // namespace detail
+
+template<>
+struct timer_wheel_position<std::shared_ptr<detail::ScheduledTask>>
+{
+    static TimerWheelPosition * get(std::shared_ptr<detail::ScheduledTask> & task) { return &task->position; }
+};
+
+namespace detail
+{
+    /// Timers of one pool, the TimerHandles reach it to unlink a cancelled timer
+    struct TimerQueue
+    {
+        std::mutex                                 mutex;
+        TimerWheel<std::shared_ptr<ScheduledTask>> wheel;          // under mutex
+        bool                                       done = false;   // stopped for good, under mutex
+    };
+}   // namespace detail
+
+/// Returned by ThreadPool::schedule_*(), cancel() stops a timer that has not fired yet (or its next period)
+class TimerHandle
+{
+public:
+    TimerHandle() = default;
+    explicit TimerHandle(std::shared_ptr<detail::ScheduledTask> task) : m_task(std::move(task)) {}
+
+    /// A pending timer leaves the wheel right away, it no longer counts as pending anywhere
+    void cancel()
+    {
+        if(!m_task)
+            return;
+
+        m_task->cancelled = true;
+        if(auto queue = m_task->queue.lock())
+        {
+            std::lock_guard<std::mutex> lk(queue->mutex);
+            if(!queue->done)
+                queue->wheel.remove(m_task->position);
+        }
+    }
+
+    bool valid() const { return m_task != nullptr; }
+
 private:
+    std::shared_ptr<detail::ScheduledTask> m_task;
+};
+
+class ThreadPool : public Executor
+{
+private:
+    /// The enqueue time gives the queue wait the elastic pool grows on
+    struct queued_task
+    {
+        TaskFunction                          task;
+        std::chrono::steady_clock::time_point enqueued;
+    };
+
+    using lane_queues = std::array<WorkStealingQueue<queued_task>, kNumTaskPriorities>;
+
+    /// A lower lane is served out of order after it was passed over that many times
+    static constexpr std::size_t kStarvationLimit = 32;
+
+    /// The timer thread checks the load of an elastic pool every grow_latency, but not more often than that
+    static constexpr std::chrono::nanoseconds kMinLoadCheckInterval{1000000};
+
+    /// How often wait() re-checks a std::future, which can not notify on completion
+    static constexpr std::chrono::milliseconds kWaitPollInterval{1};
+
+    /// Handler posted to the io_service for every queued task, asio takes its storage from the BlockPool
+    struct RunToken
+    {
+        using allocator_type = PoolAllocator<void>;
+
+        allocator_type get_allocator() const noexcept { return allocator_type(); }
+        void           operator()() { pool->run_pending_task(); }
+
+        ThreadPool * pool;
+    };
+
+    /// How post_task() accounts for the queue slot of a task
+    enum class Admission
+    {
+        bounded,    // subject to the queue capacity and the overflow policy
+        reserved,   // the caller has reserved the slot already
+        unbounded   // the pool's own traffic (timer expiries) that must not wait for producers
+    };
+
+    /// Opened first thing in a submit overload, so the promise and the context it creates are counted too
+    struct SubmitScope
+    {
+        explicit SubmitScope(ThreadPool & p) : pool(p), allocs_before(detail::tls_num_heap_allocations) {}
+
+        ~SubmitScope()
+        {
+            pool.m_num_submits += num_submits;
+            pool.m_num_submit_allocations += detail::tls_num_heap_allocations - allocs_before;
+        }
+
+        ThreadPool &      pool;
+        const std::size_t allocs_before;
+        std::size_t       num_submits = 1;
+    };
+
+    /// Posted once per worker for a bulk submission, keeps running tasks until the lanes are empty
+    struct DrainToken
+    {
+        using allocator_type = PoolAllocator<void>;
+
+        allocator_type get_allocator() const noexcept { return allocator_type(); }
+        void           operator()()
+        {
+            while(pool->run_pending_task())
+            {}
+        }
+
+        ThreadPool * pool;
+    };
+
+    PoolBackend                   m_backend;
     boost::asio::io_service       m_io_serv;
     boost::asio::io_service::work m_work;
-    std::vector<std::thread>      m_threads;
     std::atomic_size_t            m_num_tasks;
+    std::atomic_size_t            m_num_submits;
+    std::atomic_size_t            m_num_submit_allocations;
+    std::atomic_size_t            m_num_cancelled;
+
+    // priority lanes shared by the workers of every node, per-worker lanes of the work_stealing backend
+    std::vector<std::unique_ptr<lane_queues>>          m_node_lanes;
+    std::vector<std::size_t>                           m_worker_node;
+    std::vector<std::size_t>                           m_cpu_node;
+    std::array<std::atomic_size_t, kNumTaskPriorities> m_lane_depth{};
+    std::array<std::atomic_size_t, kNumTaskPriorities> m_lane_skips{};
+    std::vector<std::unique_ptr<lane_queues>>          m_local_queues;
+    std::atomic_size_t                                 m_num_queued;
+    std::atomic_size_t                                 m_queue_high_water{0};
+    std::atomic_size_t                                 m_num_sleeping;
+    std::atomic_bool                                   m_done;
+    std::mutex                                         m_wake_mutex;
+    std::condition_variable                            m_wake_cv;
+
+    // delayed and periodic tasks, the timer thread is started by the first schedule_*() call
+    using timer_wheel = TimerWheel<std::shared_ptr<detail::ScheduledTask>>;
+
+    std::shared_ptr<detail::TimerQueue>   m_timers = std::make_shared<detail::TimerQueue>();
+    std::condition_variable               m_timer_cv;   // with m_timers->mutex
+    std::thread                           m_timer_thread;
+    std::chrono::steady_clock::time_point m_timer_wakeup = std::chrono::steady_clock::time_point::min();
+
+    // worker slots, the first m_min_workers are started at construction, the rest on demand
+    std::size_t                                        m_min_workers;
+    std::size_t                                        m_max_workers;
+    std::chrono::nanoseconds                           m_grow_latency;
+    std::chrono::nanoseconds                           m_idle_timeout;
+    std::vector<std::thread>                           m_threads;
+    std::vector<std::vector<int>>                      m_worker_cpus;
+    std::vector<char>                                  m_slot_active;
+    std::vector<std::chrono::steady_clock::time_point> m_slot_started;
+    std::chrono::nanoseconds                           m_retired_worker_time{0};
+    mutable std::mutex                                 m_workers_mutex;
+    std::atomic_size_t                                 m_num_workers{0};
+    std::atomic_size_t                                 m_num_workers_added{0};
+    std::atomic_size_t                                 m_num_workers_retired{0};
+
+    // load statistics, the timer thread compares them between checks to decide on growing
+    std::atomic_size_t                    m_num_busy{0};
+    std::atomic_size_t                    m_num_completed{0};
+    std::atomic<std::int64_t>             m_busy_ns{0};
+    std::atomic<std::int64_t>             m_queue_wait_ns{0};
+    std::int64_t                          m_checked_wait_ns   = 0;
+    std::size_t                           m_checked_completed = 0;
+    std::chrono::steady_clock::time_point m_next_load_check;
+
+    // backpressure of a bounded pool, producers blocked by OverflowPolicy::block wait on m_space_cv
+    std::size_t             m_queue_capacity;
+    OverflowPolicy          m_overflow;
+    std::mutex              m_space_mutex;
+    std::condition_variable m_space_cv;
+    std::atomic_size_t      m_num_blocked_producers{0};
+    std::atomic_size_t      m_num_blocked{0};
+    std::atomic_size_t      m_num_ran_on_caller{0};
+    std::atomic_size_t      m_num_rejected{0};
+
+    // shutdown, see drain(): from m_draining on only tasks running on the pool may submit, from m_discarding
+    // on nothing is run any more
+    std::atomic_bool   m_draining{false};
+    std::atomic_bool   m_discarding{false};
+    std::atomic_size_t m_num_dropped{0};
+
+    inline static thread_local ThreadPool * tls_owner    = nullptr;
+    inline static thread_local std::size_t  tls_index    = 0;
+    inline static thread_local ThreadPool * tls_running  = nullptr;   // inside a task of this pool
+    inline static thread_local ThreadPool * tls_refusing = nullptr;   // see refuse()
 
 public:
     ThreadPool(const ThreadPool &) = delete;
     ThreadPool & operator=(const ThreadPool &) = delete;
 
-    ThreadPool() : m_io_serv(), m_work(m_io_serv), m_num_tasks(0)
-    {
-        uint32_t    num_cores = std::thread::hardware_concurrency();
-        std::size_t pool_size = std::max<uint32_t>(1, num_cores - 1);   // 2 threads on single core system
-        create_pool_threads(pool_size);
-    }
+    ThreadPool(PoolBackend backend = PoolBackend::io_service) : ThreadPool(PoolConfig{0, backend, {}}) {}
 
-    ThreadPool(std::size_t pool_size) : m_io_serv(), m_work(m_io_serv), m_num_tasks(0)
+    ThreadPool(std::size_t pool_size, PoolBackend backend = PoolBackend::io_service) :
+        ThreadPool(PoolConfig{std::max<std::size_t>(1, pool_size), backend, {}})
+    {}
+
+    /**
+     * Workers are spread over the NUMA nodes in contiguous blocks and pinned to the CPUs of their node.
+     * An elastic pool (config.max_threads > config.num_threads) is watched by the timer thread: a worker is
+     * added when every worker is busy and the queue wait has exceeded grow_latency over the last check.
+     */
+    explicit ThreadPool(const PoolConfig & config) :
+        m_backend(config.backend),
+        m_io_serv(),
+        m_work(m_io_serv),
+        m_num_tasks(0),
+        m_num_submits(0),
+        m_num_submit_allocations(0),
+        m_num_cancelled(0),
+        m_num_queued(0),
+        m_num_sleeping(0),
+        m_done(false),
+        m_grow_latency(config.grow_latency),
+        m_idle_timeout(config.idle_timeout),
+        m_queue_capacity(config.queue_capacity),
+        m_overflow(config.overflow)
     {
-        create_pool_threads(pool_size);
+        std::size_t pool_size = config.num_threads;
+        if(pool_size == 0)
+        {
+            uint32_t num_cores = std::thread::hardware_concurrency();
+            pool_size          = std::max<uint32_t>(1, num_cores - 1);   // 2 threads on single core system
+        }
+
+        m_min_workers = pool_size;
+        m_max_workers = std::max(pool_size, config.max_threads);
+        create_pool_threads(config);
+
+        if(m_max_workers > m_min_workers)
+        {
+            std::lock_guard<std::mutex> lk(m_timers->mutex);
+            start_timer_thread();
+        }
     }
 
+    /// Without an earlier drain() the queued tasks are dropped right away, their futures are cancelled
     ~ThreadPool()
     {
-        // Force all threads to return from io_service::run().
+        drain(std::chrono::steady_clock::duration::zero());
+
+        // Force all threads to return from io_service::run() or from the work stealing loop.
         m_io_serv.stop();
+        {
+            std::lock_guard<std::mutex> lk(m_wake_mutex);
+            m_done = true;
+        }
+        m_wake_cv.notify_all();
+        { std::lock_guard<std::mutex> lk(m_space_mutex); }
+        m_space_cv.notify_all();
+
+        // No worker is added after m_done, the slots can be taken out of the lock and joined
+        std::vector<std::thread> threads;
+        {
+            std::lock_guard<std::mutex> lk(m_workers_mutex);
+            threads.swap(m_threads);
+        }
 
-        for(auto & th : m_threads)
+        for(auto & th : threads)
         {
             if(th.joinable())
                 th.join();
@@ -46,44 +390,1179 @@ public:
     }
 
     std::size_t getNumTasks() const { return m_num_tasks; }
+    std::size_t getNumWorkers() const { return m_num_workers; }
+    PoolBackend getBackend() const { return m_backend; }
+    std::size_t getNumNodes() const { return m_node_lanes.size(); }
+    std::size_t getWorkerNode(std::size_t worker) const { return m_worker_node[worker]; }
 
+    PoolStats getStats() const
+    {
+        const auto  now = std::chrono::steady_clock::now();
+        PoolStats   stats;
+        std::size_t num_busy = m_num_busy;
+
+        stats.num_workers         = m_num_workers;
+        stats.num_busy            = std::min(num_busy, stats.num_workers);   // nested wait() counts twice
+        stats.num_queued          = m_num_queued;
+        stats.num_completed       = m_num_completed;
+        stats.num_workers_added   = m_num_workers_added;
+        stats.num_workers_retired = m_num_workers_retired;
+        stats.num_cancelled       = m_num_cancelled;
+        stats.queue_capacity      = m_queue_capacity;
+        stats.queue_high_water    = m_queue_high_water;
+        stats.num_blocked         = m_num_blocked;
+        stats.num_ran_on_caller   = m_num_ran_on_caller;
+        stats.num_rejected        = m_num_rejected;
+        stats.busy_time           = std::chrono::nanoseconds(m_busy_ns.load());
+        stats.queue_wait_time     = std::chrono::nanoseconds(m_queue_wait_ns.load());
+
+        std::lock_guard<std::mutex> lk(m_workers_mutex);
+        stats.worker_time = m_retired_worker_time;
+        for(std::size_t i = 0; i < m_slot_active.size(); ++i)
+        {
+            if(m_slot_active[i])
+                stats.worker_time += now - m_slot_started[i];
+        }
+
+        return stats;
+    }
+
+    /// Tasks waiting in the lane, not yet picked up by a worker
+    std::size_t getNumQueuedTasks(TaskPriority priority) const
+    {
+        return m_lane_depth[static_cast<std::size_t>(priority)];
+    }
+
+    /// Heap allocations made by the submit path, see getNumSubmitAllocations() / getNumSubmits()
+    std::size_t getNumSubmits() const { return m_num_submits; }
+    std::size_t getNumSubmitAllocations() const { return m_num_submit_allocations; }
+    std::size_t getNumCancelled() const { return m_num_cancelled; }
+    bool        isDraining() const { return m_draining; }
+
+    /**
+     * Shut the pool down gracefully. Threads outside the pool can not submit any more: their futures are
+     * cancelled right away, try_submit() fails, post() is dropped. Queued tasks, and whatever they submit
+     * themselves, keep running until the queues are empty or the timeout expires; the calling thread helps.
+     * Tasks still queued at the deadline are dropped with a cancelled future, pending timers never fire.
+     * Continuations passed to execute() are never dropped, they run inline - a Future must not be left
+     * unresolved. The workers stay alive until destruction, tasks already running are not interrupted.
+     * Call it from outside the pool, a task waiting for its own pool to drain always hits the timeout.
+     */
+    DrainReport drain(std::chrono::steady_clock::duration timeout)
+    {
+        const auto        deadline        = std::chrono::steady_clock::now() + timeout;
+        const std::size_t completed_start = m_num_completed;
+        const std::size_t dropped_start   = m_num_dropped;
+        DrainReport       report;
+
+        m_draining = true;
+        { std::lock_guard<std::mutex> lk(m_space_mutex); }
+        m_space_cv.notify_all();   // blocked producers are refused now
+
+        report.num_timers_dropped = stop_timers();
+
+        help_until(
+            [this, deadline] { return m_num_tasks == 0 || std::chrono::steady_clock::now() >= deadline; },
+            kWaitPollInterval);
+
+        report.completed     = m_num_tasks == 0;
+        report.num_completed = m_num_completed - completed_start;
+        if(!report.completed)
+        {
+            m_discarding = true;
+            while(run_pending_task())
+            {}
+        }
+
+        report.num_dropped = m_num_dropped - dropped_start;
+        report.num_running = m_num_tasks;
+        return report;
+    }
+
+    /**
+     * The callable and its promise are moved into one TaskFunction, the future shared state comes from the
+     * BlockPool. Callables that fit TaskFunction::kInlineSize do not touch the global allocator once the
+     * pool has warmed up.
+     */
     template<typename FunctionType>
     auto submit(FunctionType && f)
     {
-        using result_type = typename std::result_of<FunctionType()>::type;
-        using task_type   = typename std::packaged_task<result_type()>;
+        return submit(TaskPriority::normal, std::forward<FunctionType>(f));
+    }
 
-        // https://stackoverflow.com/questions/13157502/how-do-you-post-a-boost-packaged-task-to-an-io-service-in-c03
-        auto ff = [this, f = std::forward<FunctionType>(f)]() -> result_type {
-            return wrap_task(std::move(f));
-        };
-        auto                     task = std::make_shared<task_type>(std::move(ff));
-        std::future<result_type> res  = task->get_future();
+    template<typename FunctionType>
+    auto submit(TaskPriority priority, FunctionType && f)
+    {
+        SubmitScope submit_scope(*this);
+        using result_type = typename std::result_of<std::decay_t<FunctionType>()>::type;
+
+        std::promise<result_type> promise(std::allocator_arg, PoolAllocator<result_type>());
+        std::future<result_type>  res = promise.get_future();
+        post_promised_task(priority, std::move(promise), std::forward<FunctionType>(f));
+
+        return res;
+    }
+
+    /**
+     * The task is dropped when the token is cancelled before a worker picks it up, its future then throws
+     * TaskCancelled. A running task polls the token itself (it captures a copy of it).
+     */
+    template<typename FunctionType>
+    auto submit(CancellationToken token, FunctionType && f)
+    {
+        return submit(TaskPriority::normal, std::move(token), std::forward<FunctionType>(f));
+    }
+
+    template<typename FunctionType>
+    auto submit(TaskPriority priority, CancellationToken token, FunctionType && f)
+    {
+        SubmitScope submit_scope(*this);
+        using result_type = typename std::result_of<std::decay_t<FunctionType>()>::type;
+
+        std::promise<result_type> promise(std::allocator_arg, PoolAllocator<result_type>());
+        std::future<result_type>  res = promise.get_future();
+        post_cancellable_task(priority, std::move(token), std::move(promise), std::forward<FunctionType>(f));
+
+        return res;
+    }
+
+    /// Never waits and never runs f inline: an empty optional when the bounded queue is full
+    template<typename FunctionType>
+    auto try_submit(FunctionType && f)
+    {
+        return try_submit(TaskPriority::normal, std::forward<FunctionType>(f));
+    }
+
+    template<typename FunctionType>
+    auto try_submit(TaskPriority priority, FunctionType && f)
+    {
+        using result_type = typename std::result_of<std::decay_t<FunctionType>()>::type;
+
+        std::optional<std::future<result_type>> res;
+        if(refusing() || !try_reserve_slots(1))
+        {
+            ++m_num_rejected;
+            return res;
+        }
+
+        SubmitScope submit_scope(*this);
+
+        std::promise<result_type> promise(std::allocator_arg, PoolAllocator<result_type>());
+        res = promise.get_future();
+        post_promised_task(priority, std::move(promise), std::forward<FunctionType>(f), Admission::reserved);
+
+        return res;
+    }
+
+    /// Same as submit(), but the returned Future supports then() continuations scheduled on this pool
+    template<typename FunctionType>
+    auto async(FunctionType && f)
+    {
+        return async(TaskPriority::normal, std::forward<FunctionType>(f));
+    }
+
+    template<typename FunctionType>
+    auto async(TaskPriority priority, FunctionType && f)
+    {
+        SubmitScope submit_scope(*this);
+        using result_type = typename std::result_of<std::decay_t<FunctionType>()>::type;
+
+        Promise<result_type> promise(this);
+        Future<result_type>  res = promise.get_future();
+        post_promised_task(priority, std::move(promise), std::forward<FunctionType>(f));
+
+        return res;
+    }
+
+    /// A dropped task resolves the Future to the cancelled state, see Future::is_cancelled()
+    template<typename FunctionType>
+    auto async(CancellationToken token, FunctionType && f)
+    {
+        return async(TaskPriority::normal, std::move(token), std::forward<FunctionType>(f));
+    }
+
+    template<typename FunctionType>
+    auto async(TaskPriority priority, CancellationToken token, FunctionType && f)
+    {
+        SubmitScope submit_scope(*this);
+        using result_type = typename std::result_of<std::decay_t<FunctionType>()>::type;
+
+        Promise<result_type> promise(this);
+        Future<result_type>  res = promise.get_future();
+        post_cancellable_task(priority, std::move(token), std::move(promise), std::forward<FunctionType>(f));
+
+        return res;
+    }
+
+    /// Fire and forget: no result storage at all, an exception thrown by f is dropped
+    template<typename FunctionType>
+    void post(FunctionType && f)
+    {
+        post(TaskPriority::normal, std::forward<FunctionType>(f));
+    }
+
+    template<typename FunctionType>
+    void post(TaskPriority priority, FunctionType && f)
+    {
+        SubmitScope submit_scope(*this);
 
         ++m_num_tasks;
-        m_io_serv.post(std::bind(&task_type::operator(), task));
+        post_task(priority, [this, f = std::forward<FunctionType>(f)]() mutable {
+            if(!drop_if_discarding())
+            {
+                try
+                {
+                    f();
+                }
+                catch(...)
+                {}
+            }
+            --m_num_tasks;
+        });
+    }
+
+    template<typename Range, typename FunctionType>
+    Future<void> submit_bulk(Range && range, FunctionType && f)
+    {
+        return submit_bulk(TaskPriority::normal, std::forward<Range>(range), std::forward<FunctionType>(f));
+    }
+
+    /**
+     * One task f(element) per element of the range, all enqueued with one queue operation and one wakeup.
+     * The future is ready when every task has run and holds the first exception thrown, if any. The range
+     * must stay alive until then, tasks refer to its elements.
+     */
+    template<typename Range, typename FunctionType>
+    Future<void> submit_bulk(TaskPriority priority, Range && range, FunctionType && f)
+    {
+        SubmitScope submit_scope(*this);
+
+        struct Context
+        {
+            std::decay_t<FunctionType> fn;
+            std::atomic_size_t         remaining;
+            std::mutex                 mutex;
+            std::exception_ptr         error;
+            Promise<void>              promise;
+
+            Context(FunctionType && f, std::size_t count, Executor * executor) :
+                fn(std::forward<FunctionType>(f)), remaining(count), promise(executor)
+            {}
+
+            void finish_one()
+            {
+                if(--remaining > 0)
+                    return;
+
+                if(error)
+                    promise.set_exception(error);
+                else
+                    promise.set_value();
+            }
+        };
+
+        const std::size_t count = static_cast<std::size_t>(std::distance(std::begin(range), std::end(range)));
+        submit_scope.num_submits = count;
+        if(count == 0)
+            return make_ready_future();
+
+        auto ctx = std::allocate_shared<Context>(PoolAllocator<Context>(), std::forward<FunctionType>(f),
+                                                 count, this);
+        Future<void> res = ctx->promise.get_future();
+
+        const auto now = std::chrono::steady_clock::now();
+
+        std::vector<queued_task, PoolAllocator<queued_task>> tasks;
+        tasks.reserve(count);
+        for(auto & element : range)
+        {
+            TaskFunction task = [this, ctx, item = std::addressof(element)]() {
+                try
+                {
+                    if(drop_if_discarding())
+                        throw TaskCancelled();
+                    ctx->fn(*item);
+                }
+                catch(...)
+                {
+                    std::lock_guard<std::mutex> lk(ctx->mutex);
+                    if(!ctx->error)
+                        ctx->error = std::current_exception();
+                }
+                --m_num_tasks;
+                ctx->finish_one();
+            };
+            tasks.push_back(queued_task{std::move(task), now});
+        }
+
+        m_num_tasks += count;
+        post_tasks(priority, tasks.begin(), tasks.end());
 
         return res;
     }
 
+    /**
+     * Run f on the pool once the delay has passed. Timers live in a hierarchical wheel with 1 ms ticks
+     * served by one timer thread, adding or cancelling a timer is O(1) however many are pending.
+     */
+    template<typename FunctionType>
+    TimerHandle schedule_after(std::chrono::steady_clock::duration delay, FunctionType && f)
+    {
+        return schedule_after(TaskPriority::normal, delay, std::forward<FunctionType>(f));
+    }
+
+    template<typename FunctionType>
+    TimerHandle schedule_after(TaskPriority priority, std::chrono::steady_clock::duration delay,
+                               FunctionType && f)
+    {
+        return schedule_at(priority, std::chrono::steady_clock::now() + delay, std::forward<FunctionType>(f));
+    }
+
+    template<typename FunctionType>
+    TimerHandle schedule_at(std::chrono::steady_clock::time_point deadline, FunctionType && f)
+    {
+        return schedule_at(TaskPriority::normal, deadline, std::forward<FunctionType>(f));
+    }
+
+    template<typename FunctionType>
+    TimerHandle schedule_at(TaskPriority priority, std::chrono::steady_clock::time_point deadline,
+                            FunctionType && f)
+    {
+        return add_timer(deadline, std::chrono::steady_clock::duration::zero(), priority,
+                         std::forward<FunctionType>(f));
+    }
+
+    /// f runs every period until the handle is cancelled, runs never overlap - a late run is not repeated
+    template<typename FunctionType>
+    TimerHandle schedule_every(std::chrono::steady_clock::duration period, FunctionType && f)
+    {
+        return schedule_every(TaskPriority::normal, period, std::forward<FunctionType>(f));
+    }
+
+    template<typename FunctionType>
+    TimerHandle schedule_every(TaskPriority priority, std::chrono::steady_clock::duration period,
+                               FunctionType && f)
+    {
+        period = std::max(period, timer_wheel::duration(1));
+        return add_timer(std::chrono::steady_clock::now() + period, period, priority,
+                         std::forward<FunctionType>(f));
+    }
+
+    /**
+     * Block until the future is ready, running queued tasks of this pool meanwhile instead of sleeping.
+     * A task that waits for the result of a task it has submitted can not deadlock the pool this way.
+     * Safe to call from the pool workers and from any other thread.
+     */
+    template<typename T>
+    void wait(const Future<T> & future)
+    {
+        if(!future.valid())
+            throw std::future_error(std::future_errc::no_state);
+
+        if(!future.is_ready())
+            get_state(future)->on_ready([this] { wake_sleepers(true); });
+
+        help_until([&future] { return future.is_ready(); }, std::chrono::milliseconds::max());
+    }
+
+    template<typename T>
+    void wait(const std::future<T> & future)
+    {
+        if(!future.valid())
+            throw std::future_error(std::future_errc::no_state);
+
+        help_until(
+            [&future] { return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready; },
+            kWaitPollInterval);
+    }
+
+#ifdef EVNT_HAS_COROUTINES
+    /// co_await pool.schedule() continues the calling coroutine on a pool worker
+    ScheduleAwaiter schedule(TaskPriority priority = TaskPriority::normal) { return {*this, priority}; }
+#endif
+
+    /// Asio completions (sockets, timers) bound to it run on the workers of the io_service backend
+    boost::asio::io_service & getIoService() { return m_io_serv; }
+
+    /// Never dropped by drain(), see there
+    void execute(TaskPriority priority, TaskFunction task) override
+    {
+        SubmitScope submit_scope(*this);
+
+        ++m_num_tasks;
+        post_task(priority, [this, task = std::move(task)]() mutable {
+            task();
+            --m_num_tasks;
+        });
+    }
+
 private:
-    /// Wrap a task so that the available count can be decreased
+    template<typename PromiseType, typename FunctionType>
+    void post_promised_task(TaskPriority priority, PromiseType promise, FunctionType && f,
+                            Admission admission = Admission::bounded)
+    {
+        ++m_num_tasks;
+        post_task(
+            priority,
+            [this, promise = std::move(promise), f = std::forward<FunctionType>(f)]() mutable {
+                run_task(promise, f);
+            },
+            admission);
+    }
+
+    /// The token is checked when the task is dequeued, a cancelled task costs one atomic load
+    template<typename PromiseType, typename FunctionType>
+    void post_cancellable_task(TaskPriority priority, CancellationToken token, PromiseType promise,
+                               FunctionType && f)
+    {
+        ++m_num_tasks;
+        post_task(priority, [this, token = std::move(token), promise = std::move(promise),
+                             f = std::forward<FunctionType>(f)]() mutable { run_task(promise, f, &token); });
+    }
+
+    template<typename T>
+    static void cancel_promise(std::promise<T> & promise)
+    {
+        promise.set_exception(std::make_exception_ptr(TaskCancelled()));
+    }
+
+    template<typename T>
+    static void cancel_promise(Promise<T> & promise)
+    {
+        promise.set_cancelled();
+    }
+
+    /// Run a task, store its result and decrease the available count
+    template<typename PromiseType, typename FunctionType>
+    void run_task(PromiseType & promise, FunctionType & f, const CancellationToken * token = nullptr)
+    {
+        using result_type = decltype(f());
+
+        if(drop_if_discarding())
+        {
+            --m_num_tasks;
+            cancel_promise(promise);
+            return;
+        }
+
+        if(token != nullptr && token->is_cancelled())
+        {
+            --m_num_tasks;
+            ++m_num_cancelled;
+            cancel_promise(promise);
+            return;
+        }
+
+        try
+        {
+            if constexpr(std::is_void<result_type>::value)
+            {
+                f();
+                --m_num_tasks;
+                promise.set_value();
+            }
+            else
+            {
+                result_type res = f();
+                --m_num_tasks;
+                promise.set_value(std::move(res));
+            }
+        }
+        catch(const TaskCancelled &)
+        {
+            --m_num_tasks;
+            ++m_num_cancelled;
+            cancel_promise(promise);
+        }
+        catch(...)
+        {
+            --m_num_tasks;
+            promise.set_exception(std::current_exception());
+        }
+    }
+
+    /// Outside submissions are refused once drain() has started, follow-ups of running tasks only after that
+    bool refusing() const { return m_draining && (m_discarding || tls_running != this); }
+
+    bool discarding() const { return m_discarding || tls_refusing == this; }
+
+    /// Called first thing by every task wrapper that may be dropped
+    bool drop_if_discarding()
+    {
+        if(!discarding())
+            return false;
+
+        ++m_num_dropped;
+        return true;
+    }
+
+    /// Runs the wrapper in discarding mode: it resolves its future as cancelled instead of running the task
+    void refuse(TaskFunction & task)
+    {
+        ThreadPool * const prev = tls_refusing;
+        tls_refusing            = this;
+        task();
+        tls_refusing = prev;
+    }
+
+    void post_task(TaskPriority priority, TaskFunction task, Admission admission = Admission::bounded)
+    {
+        if(refusing())
+        {
+            if(admission == Admission::reserved)
+                --m_num_queued;
+            refuse(task);
+            return;
+        }
+
+        if(admission == Admission::bounded && !reserve_slot(task))
+            return;   // the queue was full (or the pool started draining), the task has run on this thread
+        if(admission == Admission::unbounded)
+            add_queued(1);
+
+        const std::size_t lane = static_cast<std::size_t>(priority);
+
+        ++m_lane_depth[lane];
+        submit_queue(lane).push(queued_task{std::move(task), std::chrono::steady_clock::now()});
+
+        if(m_backend == PoolBackend::io_service)
+            boost::asio::post(m_io_serv, RunToken{this});
+
+        // Sleeping work_stealing workers and threads blocked in wait()
+        if(m_num_sleeping > 0)
+            wake_sleepers(false);
+    }
+
+    template<typename TaskIt>
+    void post_tasks(TaskPriority priority, TaskIt first, TaskIt last)
+    {
+        const std::size_t lane  = static_cast<std::size_t>(priority);
+        const std::size_t count = static_cast<std::size_t>(std::distance(first, last));
+
+        // Not enough room for the whole batch, every task goes through the overflow policy on its own
+        if(refusing() || !try_reserve_slots(count))
+        {
+            for(; first != last; ++first)
+                post_task(priority, std::move(first->task));
+            return;
+        }
+
+        m_lane_depth[lane] += count;
+        submit_queue(lane).push_bulk(std::make_move_iterator(first), std::make_move_iterator(last));
+
+        if(m_backend == PoolBackend::io_service)
+        {
+            const std::size_t num_workers = m_num_workers;
+            const std::size_t num_tokens  = std::max<std::size_t>(1, std::min(count, num_workers));
+            for(std::size_t i = 0; i < num_tokens; ++i)
+                boost::asio::post(m_io_serv, DrainToken{this});
+        }
+
+        if(m_num_sleeping > 0)
+            wake_sleepers(count > 1);
+    }
+
+    void add_queued(std::size_t count)
+    {
+        update_high_water(m_num_queued += count);
+    }
+
+    void update_high_water(std::size_t queued)
+    {
+        std::size_t high = m_queue_high_water.load(std::memory_order_relaxed);
+        while(queued > high && !m_queue_high_water.compare_exchange_weak(high, queued))
+        {}
+    }
+
+    bool try_reserve_slots(std::size_t count)
+    {
+        if(m_queue_capacity == 0)
+        {
+            add_queued(count);
+            return true;
+        }
+
+        std::size_t queued = m_num_queued.load(std::memory_order_relaxed);
+        do
+        {
+            if(queued + count > m_queue_capacity)
+                return false;
+        } while(!m_num_queued.compare_exchange_weak(queued, queued + count));
+
+        update_high_water(queued + count);
+        return true;
+    }
+
+    /**
+     * Applies the overflow policy to a task that did not fit, false when the task has been run inline or
+     * refused. A pool worker never blocks here: with every worker waiting for a slot nobody would free one.
+     */
+    bool reserve_slot(TaskFunction & task)
+    {
+        if(try_reserve_slots(1))
+            return true;
+
+        if(m_overflow == OverflowPolicy::run_on_caller || tls_owner == this)
+        {
+            ++m_num_ran_on_caller;
+            task();
+            return false;
+        }
+
+        ++m_num_blocked;
+        bool reserved = false;
+        {
+            std::unique_lock<std::mutex> lk(m_space_mutex);
+            ++m_num_blocked_producers;
+            m_space_cv.wait(lk,
+                            [this, &reserved] { return (reserved = try_reserve_slots(1)) || m_draining; });
+            --m_num_blocked_producers;
+        }
+
+        // Waited into a drain(), the task counts as a new submission
+        if(reserved && m_draining)
+        {
+            --m_num_queued;
+            reserved = false;
+        }
+
+        if(!reserved)
+            refuse(task);
+        return reserved;
+    }
+
+    /**
+     * Tasks submitted from our own worker stay on its deque. Under work_stealing the others are dealt round
+     * robin to the deques of the workers on the submitting thread's node - producers and idle workers then
+     * rarely meet on one lock - and the thieves even out the load. Under io_service they go to the lanes of
+     * that node.
+     */
+    WorkStealingQueue<queued_task> & submit_queue(std::size_t lane)
+    {
+        if(m_backend != PoolBackend::work_stealing)
+            return (*m_node_lanes[current_node()])[lane];
+
+        if(tls_owner == this)
+            return (*m_local_queues[tls_index])[lane];
+
+        // Per submitting thread, a shared cursor would be a contended counter of its own
+        static thread_local std::size_t tls_cursor = std::hash<std::thread::id>{}(std::this_thread::get_id());
+
+        const std::size_t num_queues = m_local_queues.size();
+        const std::size_t node       = current_node();
+        for(std::size_t i = 0; i < num_queues; ++i)
+        {
+            const std::size_t index = ++tls_cursor % num_queues;
+            if(m_worker_node[index] == node)
+                return (*m_local_queues[index])[lane];
+        }
+
+        return (*m_local_queues[tls_cursor % num_queues])[lane];
+    }
+
     template<typename FunctionType>
-    auto wrap_task(FunctionType f)
+    TimerHandle add_timer(std::chrono::steady_clock::time_point deadline,
+                          std::chrono::steady_clock::duration period, TaskPriority priority,
+                          FunctionType && f)
     {
-        using result_type = typename std::result_of<FunctionType()>::type;
+        auto scheduled = std::allocate_shared<detail::ScheduledTask>(PoolAllocator<detail::ScheduledTask>());
+        scheduled->deadline = deadline;
+        scheduled->period   = period;
+        scheduled->priority = priority;
+        scheduled->task     = TaskFunction(std::forward<FunctionType>(f));
+        scheduled->queue    = m_timers;
 
-        result_type res = f();
+        arm_timer(scheduled);
+        return TimerHandle(std::move(scheduled));
+    }
+
+    void arm_timer(const std::shared_ptr<detail::ScheduledTask> & scheduled)
+    {
+        bool wake = false;
+        {
+            // A cancel() that missed the timer in the wheel has set the flag before taking the lock
+            std::lock_guard<std::mutex> lk(m_timers->mutex);
+            if(m_timers->done || scheduled->cancelled)
+                return;
+
+            start_timer_thread();
+
+            m_timers->wheel.add(scheduled->deadline, scheduled);
+            wake = scheduled->deadline < m_timer_wakeup;
+        }
+
+        if(wake)
+            m_timer_cv.notify_one();
+    }
+
+    /// A periodic task is armed again once it has run, for the next period that is still ahead
+    void run_scheduled(const std::shared_ptr<detail::ScheduledTask> & scheduled)
+    {
+        if(drop_if_discarding())
+        {
+            --m_num_tasks;
+            return;
+        }
+
+        if(!scheduled->cancelled)
+        {
+            try
+            {
+                scheduled->task();
+            }
+            catch(...)
+            {}
+        }
         --m_num_tasks;
-        return res;
+
+        if(scheduled->period == std::chrono::steady_clock::duration::zero() || scheduled->cancelled)
+            return;
+
+        const auto now = std::chrono::steady_clock::now();
+        scheduled->deadline += scheduled->period;
+        if(scheduled->deadline < now)
+            scheduled->deadline += (now - scheduled->deadline) / scheduled->period * scheduled->period
+                                   + scheduled->period;
+        arm_timer(scheduled);
     }
 
-    void create_pool_threads(std::size_t pool_size)
+    /// Stops the timer thread for good, returns the number of timers still pending
+    std::size_t stop_timers()
     {
-        for(std::size_t i = 0; i < pool_size; ++i)
+        std::size_t pending = 0;
+        {
+            std::lock_guard<std::mutex> lk(m_timers->mutex);
+            m_timers->done  = true;
+            pending         = m_timers->wheel.size();
+            m_timers->wheel = timer_wheel();
+        }
+        m_timer_cv.notify_one();
+        if(m_timer_thread.joinable())
+            m_timer_thread.join();
+
+        return pending;
+    }
+
+    /// Called with m_timers->mutex held
+    void start_timer_thread()
+    {
+        if(!m_timer_thread.joinable())
+            m_timer_thread = std::thread(&ThreadPool::timer_thread, this);
+    }
+
+    void timer_thread()
+    {
+        std::vector<std::shared_ptr<detail::ScheduledTask>> expired;
+
+        std::unique_lock<std::mutex> lk(m_timers->mutex);
+        while(!m_timers->done)
+        {
+            // Cancelled timers have left the wheel
+            m_timers->wheel.advance(std::chrono::steady_clock::now(),
+                                    [&expired](std::shared_ptr<detail::ScheduledTask> && scheduled) {
+                                        expired.push_back(std::move(scheduled));
+                                    });
+
+            if(!expired.empty())
+            {
+                lk.unlock();
+                for(auto & scheduled : expired)
+                {
+                    const TaskPriority priority = scheduled->priority;
+                    ++m_num_tasks;
+                    post_task(
+                        priority, [this, scheduled = std::move(scheduled)]() { run_scheduled(scheduled); },
+                        Admission::unbounded);
+                }
+                expired.clear();
+                lk.lock();
+                continue;
+            }
+
+            m_timer_wakeup = m_timers->wheel.next_expiry();
+            if(m_max_workers > m_min_workers)
+            {
+                const auto now = std::chrono::steady_clock::now();
+                if(now >= m_next_load_check)
+                {
+                    check_load();
+                    m_next_load_check = now + std::max(m_grow_latency, kMinLoadCheckInterval);
+                }
+                m_timer_wakeup = std::min(m_timer_wakeup, m_next_load_check);
+            }
+
+            if(m_timer_wakeup == timer_wheel::time_point::max())
+                m_timer_cv.wait(lk);
+            else
+                m_timer_cv.wait_until(lk, m_timer_wakeup);
+            m_timer_wakeup = timer_wheel::time_point::min();
+        }
+    }
+
+    /// Grow while nobody is idle and tasks either waited too long on average or did not finish at all
+    void check_load()
+    {
+        const std::int64_t wait_ns   = m_queue_wait_ns;
+        const std::size_t  completed = m_num_completed;
+        const std::int64_t waited    = wait_ns - m_checked_wait_ns;
+        const std::size_t  finished  = completed - m_checked_completed;
+        m_checked_wait_ns            = wait_ns;
+        m_checked_completed          = completed;
+
+        if(m_num_queued == 0 || m_num_sleeping > 0)
+            return;
+
+        if(finished == 0 || waited / static_cast<std::int64_t>(finished) > m_grow_latency.count())
+            add_worker();
+    }
+
+    void wake_sleepers(bool all)
+    {
+        { std::lock_guard<std::mutex> lk(m_wake_mutex); }
+        if(all)
+            m_wake_cv.notify_all();
+        else
+            m_wake_cv.notify_one();
+    }
+
+    /// Run queued tasks until ready() holds, sleep while there is nothing to run
+    template<typename Predicate>
+    void help_until(Predicate ready, std::chrono::milliseconds poll_interval)
+    {
+        while(!ready())
+        {
+            if(run_pending_task())
+                continue;
+
+            std::unique_lock<std::mutex> lk(m_wake_mutex);
+            ++m_num_sleeping;
+            if(poll_interval == std::chrono::milliseconds::max())
+                m_wake_cv.wait(lk, [this, &ready] { return m_num_queued > 0 || ready(); });
+            else
+                m_wake_cv.wait_for(lk, poll_interval, [this, &ready] { return m_num_queued > 0 || ready(); });
+            --m_num_sleeping;
+        }
+    }
+
+    /// Most important non-empty lane, unless a less important one has been passed over for too long
+    std::size_t select_lane()
+    {
+        for(std::size_t lane = kNumTaskPriorities - 1; lane > 0; --lane)
+        {
+            if(m_lane_depth[lane] > 0 && m_lane_skips[lane] >= kStarvationLimit)
+            {
+                m_lane_skips[lane] = 0;
+                return lane;
+            }
+        }
+
+        for(std::size_t lane = 0; lane < kNumTaskPriorities; ++lane)
+        {
+            if(m_lane_depth[lane] > 0)
+            {
+                for(std::size_t lower = lane + 1; lower < kNumTaskPriorities; ++lower)
+                {
+                    if(m_lane_depth[lower] > 0)
+                        ++m_lane_skips[lower];
+                }
+
+                return lane;
+            }
+        }
+
+        return kNumTaskPriorities;
+    }
+
+    bool pop_task_from_local_queue(std::size_t lane, queued_task & task)
+    {
+        return m_backend == PoolBackend::work_stealing && tls_owner == this
+               && (*m_local_queues[tls_index])[lane].try_pop(task);
+    }
+
+    /// NUMA node of the calling thread, threads running outside the configured CPUs count as node 0
+    std::size_t current_node() const
+    {
+        if(m_node_lanes.size() == 1)
+            return 0;
+        if(tls_owner == this)
+            return m_worker_node[tls_index];
+
+#ifdef __linux__
+        const int cpu = sched_getcpu();
+        if(cpu >= 0 && static_cast<std::size_t>(cpu) < m_cpu_node.size())
+            return m_cpu_node[cpu];
+#endif
+        return 0;
+    }
+
+    /// Own node first, the lanes of remote nodes only when it has nothing left. Empty under work_stealing
+    bool pop_task_from_global_queue(std::size_t lane, queued_task & task)
+    {
+        if(m_backend == PoolBackend::work_stealing)
+            return false;
+
+        const std::size_t num_nodes = m_node_lanes.size();
+        const std::size_t home      = current_node();
+        for(std::size_t i = 0; i < num_nodes; ++i)
+        {
+            if((*m_node_lanes[(home + i) % num_nodes])[lane].try_steal(task))
+                return true;
+        }
+
+        return false;
+    }
+
+    bool pop_task_from_other_thread_queue(std::size_t lane, queued_task & task)
+    {
+        static thread_local std::minstd_rand rng(std::random_device{}());
+
+        const std::size_t num_queues = m_local_queues.size();
+        if(num_queues == 0)
+            return false;
+
+        // Victims on the own node are tried before remote ones
+        const std::size_t home   = current_node();
+        const std::size_t victim = rng() % num_queues;
+        for(bool remote : {false, true})
+        {
+            for(std::size_t i = 0; i < num_queues; ++i)
+            {
+                const std::size_t index = (victim + i) % num_queues;
+                if((tls_owner == this && index == tls_index) || (m_worker_node[index] != home) != remote)
+                    continue;
+
+                if((*m_local_queues[index])[lane].try_steal(task))
+                    return true;
+            }
+        }
+
+        return false;
+    }
+
+    bool pop_task_from_lane(std::size_t lane, queued_task & task)
+    {
+        if(pop_task_from_local_queue(lane, task) || pop_task_from_global_queue(lane, task)
+           || pop_task_from_other_thread_queue(lane, task))
+        {
+            --m_lane_depth[lane];
+            --m_num_queued;
+            if(m_num_blocked_producers > 0)
+            {
+                { std::lock_guard<std::mutex> lk(m_space_mutex); }
+                m_space_cv.notify_one();
+            }
+            return true;
+        }
+
+        return false;
+    }
+
+    bool pop_task(queued_task & task)
+    {
+        const std::size_t first = select_lane();
+        if(first == kNumTaskPriorities)
+            return false;
+
+        if(pop_task_from_lane(first, task))
+            return true;
+
+        for(std::size_t lane = 0; lane < kNumTaskPriorities; ++lane)
+        {
+            if(lane != first && pop_task_from_lane(lane, task))
+                return true;
+        }
+
+        return false;
+    }
+
+    bool run_pending_task()
+    {
+        queued_task task;
+        if(!pop_task(task))
+            return false;
+
+        using std::chrono::nanoseconds;
+
+        const auto start = std::chrono::steady_clock::now();
+        m_queue_wait_ns += std::chrono::duration_cast<nanoseconds>(start - task.enqueued).count();
+
+        ThreadPool * const prev = tls_running;
+        tls_running             = this;
+        ++m_num_busy;
+        task.task();
+        --m_num_busy;
+        tls_running = prev;
+
+        const auto finish = std::chrono::steady_clock::now();
+        m_busy_ns += std::chrono::duration_cast<nanoseconds>(finish - start).count();
+        ++m_num_completed;
+        return true;
+    }
+
+    /// Best effort: a CPU may be offline or outside of the process cpuset, the worker then stays unpinned
+    static void pin_current_thread(const std::vector<int> & cpus)
+    {
+#ifdef __linux__
+        if(cpus.empty())
+            return;
+
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for(int cpu : cpus)
         {
-            m_threads.emplace_back([this]() { m_io_serv.run(); });
+            if(cpu >= 0 && cpu < CPU_SETSIZE)
+                CPU_SET(cpu, &set);
         }
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#endif
+    }
+
+    void bind_worker(std::size_t index, const std::vector<int> & cpus)
+    {
+        tls_owner = this;
+        tls_index = index;
+        pin_current_thread(cpus);
+    }
+
+    void worker_thread(std::size_t index)
+    {
+        while(!m_done)
+        {
+            if(run_pending_task())
+                continue;
+
+            std::unique_lock<std::mutex> lk(m_wake_mutex);
+            ++m_num_sleeping;
+            const bool woken =
+                m_wake_cv.wait_for(lk, m_idle_timeout, [this] { return m_done || m_num_queued > 0; });
+            --m_num_sleeping;
+            lk.unlock();
+
+            // An idle worker has nothing on its own deque, nothing is lost when it leaves
+            if(!woken && try_retire(index))
+                return;
+        }
+    }
+
+    void io_worker_thread(std::size_t index)
+    {
+        if(m_max_workers == m_min_workers)
+        {
+            m_io_serv.run();
+            return;
+        }
+
+        while(!m_io_serv.stopped())
+        {
+            if(m_io_serv.run_one_for(m_idle_timeout) == 0 && !m_io_serv.stopped() && try_retire(index))
+                return;
+        }
+    }
+
+    /// Called with m_workers_mutex held (or from the constructor)
+    void start_worker(std::size_t index)
+    {
+        if(m_threads[index].joinable())
+            m_threads[index].join();   // a retired worker, it has already left its loop
+
+        m_slot_active[index]  = true;
+        m_slot_started[index] = std::chrono::steady_clock::now();
+        ++m_num_workers;
+
+        m_threads[index] = std::thread([this, index]() {
+            bind_worker(index, m_worker_cpus[index]);
+            if(m_backend == PoolBackend::work_stealing)
+                worker_thread(index);
+            else
+                io_worker_thread(index);
+        });
+    }
+
+    bool add_worker()
+    {
+        std::lock_guard<std::mutex> lk(m_workers_mutex);
+        if(m_done || m_num_workers >= m_max_workers)
+            return false;
+
+        for(std::size_t i = 0; i < m_slot_active.size(); ++i)
+        {
+            if(!m_slot_active[i])
+            {
+                start_worker(i);
+                ++m_num_workers_added;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    bool try_retire(std::size_t index)
+    {
+        std::lock_guard<std::mutex> lk(m_workers_mutex);
+        if(m_done || m_num_workers <= m_min_workers)
+            return false;
+
+        m_slot_active[index] = false;
+        m_retired_worker_time += std::chrono::steady_clock::now() - m_slot_started[index];
+        --m_num_workers;
+        ++m_num_workers_retired;
+        return true;
+    }
+
+    void create_pool_threads(const PoolConfig & config)
+    {
+        const std::size_t num_nodes = std::max<std::size_t>(1, config.node_cpus.size());
+        for(std::size_t node = 0; node < num_nodes; ++node)
+        {
+            m_node_lanes.push_back(std::make_unique<lane_queues>());
+            if(node < config.node_cpus.size())
+            {
+                for(int cpu : config.node_cpus[node])
+                {
+                    if(cpu < 0)
+                        continue;
+                    if(static_cast<std::size_t>(cpu) >= m_cpu_node.size())
+                        m_cpu_node.resize(cpu + 1, 0);
+                    m_cpu_node[cpu] = node;
+                }
+            }
+        }
+
+        // Contiguous blocks of initial workers per node, so neighbouring workers share a node. Slots of
+        // workers added under load go round robin over the nodes and get the whole node.
+        const std::size_t pool_size = m_min_workers;
+        m_worker_cpus.resize(m_max_workers);
+        for(std::size_t i = 0; i < m_max_workers; ++i)
+        {
+            const std::size_t node = i < pool_size ? i * num_nodes / pool_size : (i - pool_size) % num_nodes;
+            m_worker_node.push_back(node);
+            if(node >= config.node_cpus.size() || config.node_cpus[node].empty())
+                continue;
+
+            const std::vector<int> & cpus = config.node_cpus[node];
+            if(config.pin_each_worker && i < pool_size)
+            {
+                const std::size_t first_of_node = (node * pool_size + num_nodes - 1) / num_nodes;
+                m_worker_cpus[i].push_back(cpus[(i - first_of_node) % cpus.size()]);
+            }
+            else
+                m_worker_cpus[i] = cpus;
+        }
+
+        if(m_backend == PoolBackend::work_stealing)
+        {
+            for(std::size_t i = 0; i < m_max_workers; ++i)
+                m_local_queues.push_back(std::make_unique<lane_queues>());
+        }
+
+        m_threads.resize(m_max_workers);
+        m_slot_active.resize(m_max_workers, false);
+        m_slot_started.resize(m_max_workers);
+
+        std::lock_guard<std::mutex> lk(m_workers_mutex);
+        for(std::size_t i = 0; i < pool_size; ++i)
+            start_worker(i);
     }
 };
 }   // namespace evnt
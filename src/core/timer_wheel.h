@@ -0,0 +1,217 @@
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace evnt
+{
+/// Where a TimerWheel has filed a timer, see TimerWheel::remove()
+struct TimerWheelPosition
+{
+    static constexpr std::uint32_t kNone = ~std::uint32_t(0);
+
+    std::uint32_t level = kNone;   // kNone while the timer is not in a wheel
+    std::uint32_t slot  = 0;
+    std::size_t   index = 0;
+};
+
+/// Specialize with a get(T &) returning the TimerWheelPosition a value carries to use TimerWheel<T>::remove()
+template<typename T>
+struct timer_wheel_position
+{
+    static TimerWheelPosition * get(T &) { return nullptr; }
+};
+
+/**
+ * Hierarchical timing wheel: kLevels wheels of kSlots slots, every level counts in units of kSlots ticks of
+ * the level below. Adding a timer is O(1), a timer is moved down one level at most kLevels - 1 times before
+ * it expires. Deadlines further away than the wheel span are parked in the outermost level and re-inserted
+ * when it cascades. Values with a timer_wheel_position are kept informed of their position and can be
+ * removed in O(1). Not thread safe, the owner serializes access.
+ */
+template<typename T>
+class TimerWheel
+{
+public:
+    using clock      = std::chrono::steady_clock;
+    using time_point = clock::time_point;
+    using duration   = clock::duration;
+
+    static constexpr std::size_t kSlotBits = 6;
+    static constexpr std::size_t kSlots    = std::size_t(1) << kSlotBits;
+    static constexpr std::size_t kLevels   = 4;
+
+    explicit TimerWheel(duration tick = std::chrono::milliseconds(1), time_point start = clock::now()) :
+        m_tick(tick), m_start(start)
+    {}
+
+    std::size_t size() const { return m_size; }
+    bool        empty() const { return m_size == 0; }
+
+    void add(time_point deadline, T value)
+    {
+        // An idle wheel has not been advanced for a while, catch up first so the new delta is small
+        if(m_size == 0)
+            m_now = std::max(m_now, ticks_elapsed(clock::now()));
+
+        insert(Entry{std::max(ticks_until(deadline), m_now), std::move(value)});
+    }
+
+    /// Unlinks the timer filed at position, false if it is not in the wheel (any more)
+    bool remove(TimerWheelPosition & position)
+    {
+        if(position.level == TimerWheelPosition::kNone)
+            return false;
+
+        slot_type &       slot  = m_slots[position.level][position.slot];
+        const std::size_t index = position.index;
+        position.level          = TimerWheelPosition::kNone;
+
+        // Destroyed on return, position may live in the value itself
+        Entry removed = std::move(slot[index]);
+        if(index + 1 != slot.size())
+        {
+            slot[index] = std::move(slot.back());
+            position_of(slot[index].value)->index = index;
+        }
+        slot.pop_back();
+        --m_size;
+
+        return true;
+    }
+
+    /// Calls on_expired(T &&) for every timer whose deadline is not later than now
+    template<typename Function>
+    void advance(time_point now, Function && on_expired)
+    {
+        const std::uint64_t target = ticks_elapsed(now);
+        if(m_size == 0)
+        {
+            m_now = std::max(m_now, target);
+            return;
+        }
+
+        while(m_size > 0 && m_now <= target)
+            tick(on_expired);
+    }
+
+    /// Earliest moment advance() can have something to do, time_point::max() for an empty wheel
+    time_point next_expiry() const
+    {
+        if(m_size == 0)
+            return time_point::max();
+
+        for(std::uint64_t t = m_now; t < (m_now | (kSlots - 1)) + 1; ++t)
+        {
+            if(!m_slots[0][t & (kSlots - 1)].empty())
+                return time_of(t);
+        }
+
+        // Nothing on the innermost wheel, the next cascade refills it
+        return time_of((m_now | (kSlots - 1)) + 1);
+    }
+
+private:
+    struct Entry
+    {
+        std::uint64_t expiry;
+        T             value;
+    };
+
+    using slot_type = std::vector<Entry>;
+
+    static constexpr std::uint64_t kSpan = std::uint64_t(1) << (kSlotBits * kLevels);
+
+    static TimerWheelPosition * position_of(T & value) { return timer_wheel_position<T>::get(value); }
+
+    /// First tick at or after tp, a timer never fires early
+    std::uint64_t ticks_until(time_point tp) const
+    {
+        if(tp <= m_start)
+            return 0;
+
+        return static_cast<std::uint64_t>((tp - m_start + m_tick - duration(1)) / m_tick);
+    }
+
+    /// Last tick at or before tp
+    std::uint64_t ticks_elapsed(time_point tp) const
+    {
+        if(tp <= m_start)
+            return 0;
+
+        return static_cast<std::uint64_t>((tp - m_start) / m_tick);
+    }
+
+    time_point time_of(std::uint64_t ticks) const
+    {
+        return m_start + m_tick * static_cast<std::int64_t>(ticks);
+    }
+
+    void insert(Entry entry)
+    {
+        const std::uint64_t slot_tick = std::min(entry.expiry, m_now + kSpan - 1);
+        const std::uint64_t delta     = slot_tick - m_now;
+
+        std::size_t level = 0;
+        while(level + 1 < kLevels && delta >= (std::uint64_t(1) << (kSlotBits * (level + 1))))
+            ++level;
+
+        const std::size_t slot_index = (slot_tick >> (kSlotBits * level)) & (kSlots - 1);
+        slot_type &       slot       = m_slots[level][slot_index];
+        if(TimerWheelPosition * position = position_of(entry.value))
+        {
+            position->level = static_cast<std::uint32_t>(level);
+            position->slot  = static_cast<std::uint32_t>(slot_index);
+            position->index = slot.size();
+        }
+
+        slot.push_back(std::move(entry));
+        ++m_size;
+    }
+
+    template<typename Function>
+    void tick(Function & on_expired)
+    {
+        take_slot(m_slots[0][m_now & (kSlots - 1)]);
+        for(auto & entry : m_scratch)
+        {
+            if(TimerWheelPosition * position = position_of(entry.value))
+                position->level = TimerWheelPosition::kNone;
+            on_expired(std::move(entry.value));
+        }
+        m_scratch.clear();
+
+        ++m_now;
+        for(std::size_t level = 1; level < kLevels; ++level)
+        {
+            if((m_now & ((std::uint64_t(1) << (kSlotBits * level)) - 1)) != 0)
+                break;
+
+            take_slot(m_slots[level][(m_now >> (kSlotBits * level)) & (kSlots - 1)]);
+            for(auto & entry : m_scratch)
+                insert(std::move(entry));
+            m_scratch.clear();
+        }
+    }
+
+    void take_slot(slot_type & slot)
+    {
+        m_scratch.swap(slot);
+        m_size -= m_scratch.size();
+    }
+
+    duration                                           m_tick;
+    time_point                                         m_start;
+    std::uint64_t                                      m_now  = 0;
+    std::size_t                                        m_size = 0;
+    std::array<std::array<slot_type, kSlots>, kLevels> m_slots;
+    slot_type                                          m_scratch;
+};
+}   // namespace evnt
+
+#endif   // TIMERWHEEL_H
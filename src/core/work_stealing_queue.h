@@ -0,0 +1,111 @@
+#ifndef WORKSTEALINGQUEUE_H
+#define WORKSTEALINGQUEUE_H
+
+#include "pool_allocator.h"
+
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace evnt
+{
+/**
+ * Per-worker task deque. The owning thread pushes and pops at the front (LIFO - the task it has just
+ * submitted is most likely still hot in its cache), other threads steal from the back (the oldest task).
+ * Elements live in a growable ring buffer, so a steady stream of push/pop does not allocate.
+ */
+template<typename T>
+class WorkStealingQueue
+{
+public:
+    WorkStealingQueue() = default;
+
+    WorkStealingQueue(const WorkStealingQueue &) = delete;
+    WorkStealingQueue & operator=(const WorkStealingQueue &) = delete;
+
+    void push(T data)
+    {
+        std::lock_guard<std::mutex> lk(m_mutex);
+        if(m_size == m_buffer.size())
+            grow();
+
+        m_head           = (m_head + m_buffer.size() - 1) & (m_buffer.size() - 1);
+        m_buffer[m_head] = std::move(data);
+        ++m_size;
+    }
+
+    /// Pushes the whole range under one lock, the first element ends up as the oldest one
+    template<typename InputIt>
+    void push_bulk(InputIt first, InputIt last)
+    {
+        std::lock_guard<std::mutex> lk(m_mutex);
+        for(; first != last; ++first)
+        {
+            if(m_size == m_buffer.size())
+                grow();
+
+            m_head           = (m_head + m_buffer.size() - 1) & (m_buffer.size() - 1);
+            m_buffer[m_head] = std::move(*first);
+            ++m_size;
+        }
+    }
+
+    bool empty() const
+    {
+        std::lock_guard<std::mutex> lk(m_mutex);
+        return m_size == 0;
+    }
+
+    std::size_t size() const
+    {
+        std::lock_guard<std::mutex> lk(m_mutex);
+        return m_size;
+    }
+
+    bool try_pop(T & res)
+    {
+        std::lock_guard<std::mutex> lk(m_mutex);
+        if(m_size == 0)
+            return false;
+
+        res    = std::move(m_buffer[m_head]);
+        m_head = (m_head + 1) & (m_buffer.size() - 1);
+        --m_size;
+        return true;
+    }
+
+    bool try_steal(T & res)
+    {
+        std::lock_guard<std::mutex> lk(m_mutex);
+        if(m_size == 0)
+            return false;
+
+        --m_size;
+        res = std::move(m_buffer[(m_head + m_size) & (m_buffer.size() - 1)]);
+        return true;
+    }
+
+private:
+    /// Capacity is always a power of two
+    void grow()
+    {
+        buffer_type buffer(m_buffer.empty() ? kInitialCapacity : m_buffer.size() * 2);
+        for(std::size_t i = 0; i < m_size; ++i)
+            buffer[i] = std::move(m_buffer[(m_head + i) & (m_buffer.size() - 1)]);
+
+        m_buffer.swap(buffer);
+        m_head = 0;
+    }
+
+    using buffer_type = std::vector<T, PoolAllocator<T>>;
+
+    static constexpr std::size_t kInitialCapacity = 64;
+
+    buffer_type        m_buffer;
+    std::size_t        m_head = 0;
+    std::size_t        m_size = 0;
+    mutable std::mutex m_mutex;
+};
+}   // namespace evnt
+
+#endif   // WORKSTEALINGQUEUE_H
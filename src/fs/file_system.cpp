@@ -1,5 +1,6 @@
 #include "file_system.h"
 #include "../core/exception.h"
+#include "../core/parallel.h"
 #include "../log/log.h"
 #include <algorithm>
 #include <boost/filesystem.hpp>
@@ -239,6 +240,21 @@ FileSystem::FilePtr FileSystem::getFile(const std::string & fname) const
     }
 }
 
+std::vector<FileSystem::FilePtr> FileSystem::getFiles(const std::vector<std::string> & fnames,
+                                                      ThreadPool &                     pool) const
+{
+    std::vector<FilePtr> files(fnames.size());
+    parallel_transform(pool, fnames.begin(), fnames.end(), files.begin(),
+                       [this](const std::string & fname) { return getFile(fname); });
+
+    return files;
+}
+
+Future<FileSystem::FilePtr> FileSystem::getFileAsync(const std::string & fname, ThreadPool & pool) const
+{
+    return pool.async([this, fname] { return getFile(fname); });
+}
+
 bool FileSystem::writeFile(const std::string & path, FilePtr file)
 {
     std::string filename = file->getName();
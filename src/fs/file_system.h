@@ -1,6 +1,7 @@
 #ifndef FILESYSTEM_H
 #define FILESYSTEM_H
 
+#include "../core/future.h"
 #include "file.h"
 #include <functional>
 #include <list>
@@ -8,6 +9,8 @@
 
 namespace evnt
 {
+class ThreadPool;
+
 class FileSystem
 {
 public:
@@ -17,9 +20,12 @@ public:
     FileSystem(std::string root_dir);
     virtual ~FileSystem() = default;
 
-    bool    isExist(const std::string & fname) const;
-    FilePtr getFile(const std::string & fname) const;   // ex. file name: "fonts/times.ttf"
-    size_t  getNumFiles() const { return m_files.size(); }
+    bool                 isExist(const std::string & fname) const;
+    FilePtr              getFile(const std::string & fname) const;   // ex. file name: "fonts/times.ttf"
+    std::vector<FilePtr> getFiles(const std::vector<std::string> & fnames, ThreadPool & pool) const;
+    // Reads block, pass Core::getIoPool() rather than the compute pool
+    Future<FilePtr>      getFileAsync(const std::string & fname, ThreadPool & pool) const;   // awaitable
+    size_t               getNumFiles() const { return m_files.size(); }
 
     bool writeFile(const std::string & path, FilePtr file);   // Memory file
     bool createZIP(std::vector<FilePtr> filelist,
@@ -53,7 +53,7 @@ int main()
     auto res = evnt::Core::instance().raiseEvent<evIncr>(42);
 
     std::cout << res4.get() << std::endl;
-    std::cout << res[0].get() << std::endl << std::endl;
+    std::cout << res.get()[0] << std::endl << std::endl;
 
     evnt::Core::instance().removeFunctor<evIncr>(h);
 
@@ -8,6 +8,8 @@ static boost::asio::io_service io_serv;
 
 Connection::Connection() : mSocket{std::make_shared<UDPSocket>(io_serv)} {}
 
+Connection::Connection(boost::asio::io_service & io) : mSocket{std::make_shared<UDPSocket>(io)} {}
+
 void Connection::processIncomingPackets()
 {
     readIncomingPacketsIntoQueue();
@@ -77,6 +79,35 @@ void Connection::processQueuedPackets()
     }
 }
 
+Future<Connection::Datagram> Connection::receive()
+{
+    static const int packetSize = 1500;
+
+    struct ReceiveContext
+    {
+        Datagram          datagram{InputMemoryStream(packetSize), SocketAddress()};
+        Promise<Datagram> promise;
+    };
+
+    auto             ctx = std::make_shared<ReceiveContext>();
+    Future<Datagram> res = ctx->promise.get_future();
+
+    mSocket->asyncReceiveFrom(ctx->datagram.packet.getCurPosPtr(), packetSize, ctx->datagram.from,
+                              [ctx](const boost::system::error_code & err, size_t readByteCount) {
+                                  if(err)
+                                  {
+                                      ctx->promise.set_exception(
+                                          std::make_exception_ptr(boost::system::system_error(err)));
+                                      return;
+                                  }
+
+                                  ctx->datagram.packet.setCapacity(readByteCount);
+                                  ctx->promise.set_value(std::move(ctx->datagram));
+                              });
+
+    return res;
+}
+
 void Connection::sendPacket(const OutputMemoryStream & inOutputStream, const SocketAddress & inToAddress)
 {
     int sentByteCount =
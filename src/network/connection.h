@@ -1,6 +1,7 @@
 #ifndef NETWORKMANAGER_H
 #define NETWORKMANAGER_H
 
+#include "../core/future.h"
 #include "../core/memory_stream.h"
 #include "udpsocket.h"
 #include <list>
@@ -13,7 +14,14 @@ class Connection
 public:
     static const int kMaxPacketsPerFrameCount = 10;
 
+    struct Datagram
+    {
+        InputMemoryStream packet;
+        SocketAddress     from;
+    };
+
     Connection();
+    Connection(boost::asio::io_service & io);   // socket completions run where io is run
     virtual ~Connection() = default;
 
     bool init(uint16_t inPort);
@@ -24,6 +32,9 @@ public:
 
     void sendPacket(const OutputMemoryStream & inOutputStream, const SocketAddress & inToAddress);
 
+    // Asynchronous receive of one packet, the future can be co_await-ed
+    Future<Datagram> receive();
+
 private:
     // void	UpdateBytesSentLastFrame();
     void readIncomingPacketsIntoQueue();
@@ -18,6 +18,15 @@ public:
     bool   bind(const SocketAddress & inToAddress);
     size_t sendTo(const void * inToSend, size_t inLength, const SocketAddress & inToAddress);
     size_t receiveFrom(void * inToReceive, size_t inMaxLength, SocketAddress & outFromAddress);
+
+    // handler(const boost::system::error_code &, size_t) runs on the io_service the socket was created with
+    template<typename Handler>
+    void asyncReceiveFrom(void * inToReceive, size_t inMaxLength, SocketAddress & outFromAddress,
+                          Handler && handler)
+    {
+        m_socket.async_receive_from(boost::asio::buffer(inToReceive, inMaxLength), outFromAddress.m_endpoint,
+                                    std::forward<Handler>(handler));
+    }
 };
 
 using UDPSocketPtr = std::shared_ptr<UDPSocket>;